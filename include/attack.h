@@ -0,0 +1,118 @@
+#ifndef ATTACK_H
+#define ATTACK_H
+
+#include <stdint.h>
+
+#if defined(USE_PEXT) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/* precomputed attack tables. for non-sliding pieces the attacked squares    */
+/* only depend on the square the piece is on, so we can simply look them up. */
+/* for sliding pieces the attacked squares also depend on which squares are  */
+/* occupied. we use magic bitboards for those: the relevant occupied squares */
+/* are multiplied by a magic number and shifted down, which maps every       */
+/* possible occupancy to an index into a table of attack sets.               */
+/*                                                                           */
+/* when built with `make BMI2=1` the index is computed with the PEXT         */
+/* instruction instead, which gathers the masked occupancy bits directly and */
+/* doesn't need a magic number at all. both backends fill the same tables    */
+/* and must give the same attacks, `verify_attacks` checks that they do.     */
+/*                                                                           */
+/* https://www.chessprogramming.org/Magic_Bitboards                          */
+/* https://www.chessprogramming.org/BMI2#PEXTBitboards                       */
+#ifdef USE_PEXT
+#define ATTACK_BACKEND "pext"
+#else
+#define ATTACK_BACKEND "magic"
+#endif
+
+/* `slider_fill` uses AVX2 whenever the compiler targets it, which it does   */
+/* with the default `-march=native` on any recent x86 machine. otherwise it  */
+/* falls back to the table lookups.                                          */
+#ifdef __AVX2__
+#define FILL_BACKEND "avx2"
+#else
+#define FILL_BACKEND "lookup"
+#endif
+
+struct magic {
+	/* the squares that can block the slider, excluding the board edges.     */
+	uint64_t mask;
+
+	/* the magic number used to hash the masked occupancy. unused by PEXT.   */
+	uint64_t magic;
+
+	/* the attack sets for this square, indexed by the hashed occupancy.     */
+	const uint64_t *attacks;
+
+	/* the number of bits to shift the product down by.                      */
+	int shift;
+};
+
+extern uint64_t pawn_attacks[2][64];
+extern uint64_t knight_attacks[64];
+extern uint64_t king_attacks[64];
+extern struct magic rook_magics[64];
+extern struct magic bishop_magics[64];
+
+/* the squares strictly between two squares on a common rank, file or        */
+/* diagonal, or an empty bitboard if they don't share one.                   */
+extern uint64_t between_bb[64][64];
+
+/* the whole line through two squares on a common rank, file or diagonal,    */
+/* from edge to edge, or an empty bitboard if they don't share one.          */
+extern uint64_t line_bb[64][64];
+
+/* initialize the attack tables. this must be called once before any of the  */
+/* functions below, or any function that generates moves, are used.          */
+void init_attacks(void);
+
+/* compare the table lookups against a slow ray walk for every occupancy of  */
+/* every square, and `slider_fill` against the table lookups for a set of    */
+/* random positions. returns `SUCCESS` if they all match, `FAILURE`          */
+/* otherwise.                                                                */
+int verify_attacks(void);
+
+/* compute the squares attacked along ranks and files by all pieces in       */
+/* `orthogonal`, and along diagonals by all pieces in `diagonal`, at once,   */
+/* and store them in `orthogonal_attacks` and `diagonal_attacks`. queens go  */
+/* in both sets. with AVX2, instead of looking up every piece, all pieces    */
+/* are smeared along the eight directions together with Kogge-Stone          */
+/* occluded fills: the four directions that shift up and the four that       */
+/* shift down each run in the lanes of one vector.                           */
+/*                                                                           */
+/* https://www.chessprogramming.org/Kogge-Stone_Algorithm                    */
+/* https://www.chessprogramming.org/AVX2#Kogge-Stone                         */
+void slider_fill(uint64_t orthogonal, uint64_t diagonal, uint64_t occupied, uint64_t *orthogonal_attacks, uint64_t *diagonal_attacks);
+
+/* returns the index into the attack table of a slider with the given       */
+/* occupancy.                                                                */
+static inline uint64_t magic_index(const struct magic *m, uint64_t occupied) {
+#ifdef USE_PEXT
+	return _pext_u64(occupied, m->mask);
+#else
+	return ((occupied & m->mask) * m->magic) >> m->shift;
+#endif
+}
+
+/* returns the squares attacked by a rook on the given square.               */
+static inline uint64_t rook_attacks(int square, uint64_t occupied) {
+	const struct magic *m = &rook_magics[square];
+
+	return m->attacks[magic_index(m, occupied)];
+}
+
+/* returns the squares attacked by a bishop on the given square.             */
+static inline uint64_t bishop_attacks(int square, uint64_t occupied) {
+	const struct magic *m = &bishop_magics[square];
+
+	return m->attacks[magic_index(m, occupied)];
+}
+
+/* returns the squares attacked by a queen on the given square.              */
+static inline uint64_t queen_attacks(int square, uint64_t occupied) {
+	return rook_attacks(square, occupied) | bishop_attacks(square, occupied);
+}
+
+#endif
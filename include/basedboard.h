@@ -5,8 +5,34 @@
 #include "types.h"
 
 #define bb_count(bb) __builtin_popcountll(bb)
+#define bb_lsb(bb) __builtin_ctzll(bb)
 #define FILE_MASK(file) (0x8080808080808080ULL >> (file))
 #define WHITE_MASK 0xAAAAAAAAAAAAAAAAULL
 #define BLACK_MASK (~WHITE_MASK)
 
+#define SQUARE_BB(square) (1ULL << (square))
+#define RANK_BB(rank) (0xFFULL << ((rank) * 8))
+#define FILE_A_BB 0x0101010101010101ULL
+#define FILE_H_BB 0x8080808080808080ULL
+
+// Returns the index of the least significant set bit and clears it
+static inline int bb_pop_lsb(uint64_t *bb) {
+	int square = bb_lsb(*bb);
+
+	*bb &= *bb - 1;
+
+	return square;
+}
+
+// Shifts every square by the given square offset, up for positive offsets and down for negative ones
+static inline uint64_t bb_shift(uint64_t bb, int offset) {
+	return offset > 0 ? bb << offset : bb >> -offset;
+}
+
+// All pieces of one color
+static inline uint64_t color_bb(const struct position *pos, int color) {
+	return pos->colors[color];
+}
+
+// Rebuilds all bitboards, the hash keys and the piece square sums from the mailbox
 void set_bbs(struct position *pos);
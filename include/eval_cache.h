@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Static evaluations by position key. Quiescence stand pats keep evaluating the same positions, reached
+// through transpositions and again every iteration, and an evaluation costs a move generation for
+// mobility. A hit is one load of one word instead.
+// https://www.chessprogramming.org/Evaluation_Hash_Table
+
+#define EVAL_CACHE_SIZE 16384  // Entries, a power of two. 128 KB.
+
+// The upper half of an entry holds the upper half of the key, the lower half the score. The lower bits of
+// the key pick the entry, so only the upper half needs to be stored to tell positions apart.
+typedef uint64_t t_eval_entry;
+
+typedef struct {
+	t_eval_entry entries[EVAL_CACHE_SIZE];
+	uint64_t hits;
+	uint64_t misses;
+} t_eval_cache;
+
+extern t_eval_cache g_eval_cache;
+
+#define EVAL_KEY_MASK 0xFFFFFFFF00000000ULL
+
+// Stores the score of the position in score and returns true if it is cached
+static inline bool eval_cache_probe(uint64_t key, int32_t *score) {
+	t_eval_entry entry = g_eval_cache.entries[key & (EVAL_CACHE_SIZE - 1)];
+
+	if ((entry & EVAL_KEY_MASK) != (key & EVAL_KEY_MASK)) {
+		g_eval_cache.misses++;
+		return false;
+	}
+
+	g_eval_cache.hits++;
+	*score = (int32_t) (uint32_t) entry;
+	return true;
+}
+
+static inline void eval_cache_store(uint64_t key, int32_t score) {
+	g_eval_cache.entries[key & (EVAL_CACHE_SIZE - 1)] = (key & EVAL_KEY_MASK) | (uint32_t) score;
+}
+
+// Resets the hit and miss counters, the entries stay valid forever
+void eval_cache_new_search(void);
@@ -5,41 +5,138 @@
 #include "position.h"
 
 #include <stddef.h>
+#include <stdint.h>
+
+/* what it takes for a move to give check, computed once per position so    */
+/* that `gives_check` doesn't have to make the move.                         */
+struct check_info {
+	/* the squares each type of piece would give check from. for sliders     */
+	/* this uses the current occupancy, empty for the king.                  */
+	uint64_t check_squares[6];
+
+	/* our pieces that uncover an attack on the enemy king when they move    */
+	/* off the line, see `discovered_check_candidates`.                      */
+	uint64_t discovered;
+
+	/* the square of the enemy king.                                         */
+	int king_square;
+};
+
+/* everything the pieces of both sides attack, computed once per position    */
+/* and shared by move generation, legality checks, check detection and the   */
+/* evaluation, instead of each of them looking at the pieces again.          */
+struct attack_map {
+	/* the squares attacked by each piece type of each color.               */
+	uint64_t by_type[2][6];
+
+	/* the squares attacked by each color.                                   */
+	uint64_t by_color[2];
+
+	/* the pieces of each color that are pinned to their own king.           */
+	uint64_t pinned[2];
+
+	/* the opponent pieces giving check to the side to move.                 */
+	uint64_t checkers;
+
+	/* what it takes for the side to move to give check.                     */
+	struct check_info check_info;
+};
 
 /* maximum number of moves in any chess position. the actual maximum number  */
 /* of moves seems to be 218, but just to be safe we round up to the nearest  */
-/* power of two. the `moves` parameter of `generate_psuedo_legal_moves` and  */
-/* `generate_legal_moves` should be an array of size `MAX_MOVES`.            */
+/* power of two. the `moves` parameter of `generate_legal_moves` and         */
+/* `generate_moves` should have room for `MAX_MOVES` moves.                  */
 #define MAX_MOVES 256
 
-/* generate all pseudo-legal moves and store them in `moves`, which must be  */
-/* large enough to hold all pseudo-legal moves in the position. pseudo-legal */
-/* moves include moves that leave the king in check, or castling through a   */
-/* square that is controlled by an opponent piece. returns the number of     */
-/* pseudo-legal moves generated.                                             */
-/*                                                                           */
-/* POSSIBLE IMPROVEMENT: staged or chunked move generation                   */
-/* some moves such as captures and pawn promotions are likely to have a      */
-/* bigger impact on the game than quiet moves. instead of wasting time       */
-/* generating (and sorting) all moves, provide a way to generate important   */
-/* moves separately. this is especially useful for alpha-beta pruning.       */
-/*                                                                           */
-/* https://www.chessprogramming.org/Move_Generation                          */
-/* https://www.chessprogramming.org/Pseudo-Legal_Move                        */
-size_t generate_pseudo_legal_moves(const struct position *pos, struct move *moves);
+/* the kinds of moves `generate_moves` can generate. captures include all    */
+/* promotions, even the ones that don't capture anything, and en passant.   */
+/* quiet moves are all other moves, including castling. quiet checks are the */
+/* quiet moves that give check, directly or by uncovering a slider, apart    */
+/* from castling. they are only used together with captures, to search      */
+/* checks in the first ply of quiescence search.                             */
+#define GEN_CAPTURES 1
+#define GEN_QUIETS 2
+#define GEN_ALL (GEN_CAPTURES | GEN_QUIETS)
+#define GEN_QUIET_CHECKS 4
 
 /* generate all legal moves and store them in `moves`, which must be large   */
 /* enough to hold all legal moves in the position. returns the number of     */
 /* legal moves generated.                                                    */
 /*                                                                           */
-/* POSSIBLE IMPROVEMENT: getting out of check                                */
-/* in some positions, such as when in check, the number of legal moves is    */
-/* much smaller than the number of pseudo-legal moves. instead of generating */
-/* all pseudo-legal moves, write a generator specifically for moves that get */
-/* out of check.                                                             */
+/* instead of generating pseudo-legal moves and testing each of them, the    */
+/* pieces giving check and the pieces pinned to the king are computed once.  */
+/* pinned pieces may only move along the pin, and the king may only move to  */
+/* squares that are not attacked. en passant captures and castling are       */
+/* checked with attack lookups. when in check, only evasions are generated:  */
+/* the king moves out of attack, and in single check other pieces may also   */
+/* capture the checker or block the check. in double check only the king     */
+/* can move.                                                                 */
 /*                                                                           */
+/* https://www.chessprogramming.org/Pin                                      */
 /* https://www.chessprogramming.org/Check                                    */
 /* https://www.chessprogramming.org/Double_Check                             */
 size_t generate_legal_moves(const struct position *pos, struct move *moves);
 
+/* generate the legal moves of the given kinds, a combination of the `GEN_`  */
+/* flags above, and store them in `moves`. `attacks` must be the attack map  */
+/* of the position, it supplies the checkers, the pins and the squares the   */
+/* king can't move to. this lets the search generate the captures first,     */
+/* and only generate the quiet moves when none of the captures caused a      */
+/* cutoff. returns the number of moves generated.                            */
+/*                                                                           */
+/* https://www.chessprogramming.org/Move_Generation#Staged_Move_Generation   */
+size_t generate_moves(const struct position *pos, struct move *moves, int kind, const struct attack_map *attacks);
+
+/* check if a move could be played in the given position, ignoring whether  */
+/* it leaves the king in check. this is used for moves that don't come from  */
+/* the move generator, like the hash move and killer moves, which may come   */
+/* from a different position and must be checked before they are played.     */
+/* castling moves are checked completely, including attacked squares.        */
+/*                                                                           */
+/* https://www.chessprogramming.org/Pseudo-Legal_Move                        */
+int is_pseudo_legal(const struct position *pos, struct move move);
+
+/* check if a pseudo-legal move is legal. instead of making the move, this  */
+/* uses the pieces giving check and the pieces pinned to the king from the   */
+/* attack map of the position, the same way `generate_moves` does.           */
+/*                                                                           */
+/* https://www.chessprogramming.org/Legal_Move                               */
+int is_legal(const struct position *pos, struct move move, const struct attack_map *attacks);
+
+/* returns the pieces of the given color that block one of their own        */
+/* sliders from attacking the enemy king. moving such a piece off the line   */
+/* gives a discovered check.                                                 */
+/*                                                                           */
+/* https://www.chessprogramming.org/Discovered_Check                         */
+uint64_t discovered_check_candidates(const struct position *pos, int color, uint64_t occupied);
+
+/* fill in the check info for the side to move.                            */
+void init_check_info(const struct position *pos, struct check_info *info);
+
+/* compute the attack map of the position.                                   */
+void init_attack_map(const struct position *pos, struct attack_map *attacks);
+
+/* check if a legal move gives check, without making it. direct checks are   */
+/* a lookup in the check squares of the piece, discovered checks a lookup in */
+/* the candidates. only promotions, en passant and castling, which change    */
+/* the occupancy in other ways, look at the attacks after the move.          */
+/*                                                                           */
+/* https://www.chessprogramming.org/Check                                    */
+int gives_check(const struct position *pos, struct move move, const struct check_info *info);
+
+/* returns the opponent pieces giving check to the side to move.             */
+uint64_t get_checkers(const struct position *pos);
+
+/* returns all pieces of either color that attack `square`, as if the board  */
+/* had the given occupancy.                                                  */
+uint64_t attackers_to(const struct position *pos, int square, uint64_t occupied);
+
+/* check if any piece of the given color attacks `square`, as if the board   */
+/* had the given occupancy.                                                  */
+int is_square_attacked(const struct position *pos, int square, int color, uint64_t occupied);
+
+/* returns the pieces of the given color that are pinned to their king,      */
+/* which is on `king_square`.                                                */
+uint64_t pinned_pieces(const struct position *pos, int color, int king_square, uint64_t occupied);
+
 #endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "position.h"
+
+// Everything the evaluation wants to know about the material on the board, looked up by material key.
+// Material only changes on captures and promotions, and a game goes through a few dozen material
+// configurations at most, so each one is worked out once and every later node just reads its entry.
+// https://www.chessprogramming.org/Material_Hash_Table
+
+#define MATERIAL_TABLE_SIZE 4096  // Entries, a power of two
+
+#define PHASE_MAX 24      // All pieces on the board, counting 1 per minor, 2 per rook and 4 per queen
+#define SCALE_NORMAL 64   // Scales are out of this
+
+typedef struct {
+	uint64_t key;
+	int16_t imbalance;    // Added to the evaluation, from white's point of view
+	uint8_t phase;        // From PHASE_MAX in the opening down to 0 with only pawns and kings left
+	uint8_t scale[2];     // How much of a winning score of each color counts, out of SCALE_NORMAL
+	bool end_game;
+} t_material_entry;
+
+extern t_material_entry g_material_table[MATERIAL_TABLE_SIZE];
+
+// Fills in the entry for the material of the position
+void compute_material(t_material_entry *entry, const struct position *pos);
+
+static inline const t_material_entry *material_probe(const struct position *pos) {
+	t_material_entry *entry = &g_material_table[pos->material_key & (MATERIAL_TABLE_SIZE - 1)];
+
+	if (entry->key != pos->material_key) {
+		compute_material(entry, pos);
+	}
+
+	return entry;
+}
@@ -2,13 +2,13 @@
 #define MOVE_H
 
 #include "position.h"
+#include "types.h"
 
-/* this struct represents a chess move.                                      */
-/*                                                                           */
-/* POSSIBLE IMPROVEMENT: compact encoding                                    */
-/* this struct currently has three integers. a more efficient implementation */
-/* might use just a single integer, using bitwise operations to encode and   */
-/* decode the move.                                                          */
+#include <stdint.h>
+
+/* this struct represents a chess move. it is packed into 16 bits, so move   */
+/* lists are small and moves are cheap to copy around. scores used to order  */
+/* moves are kept in a separate array next to the move list.                */
 /*                                                                           */
 /* POSSIBLE IMPROVEMENT: extended move structure                             */
 /* when making (or sorting) moves, you may need some additional information  */
@@ -21,54 +21,100 @@
 /* https://www.chessprogramming.org/Encoding_Moves                           */
 struct move {
 	/* the square the piece is moving from.                                  */
-	int from_square;
+	uint16_t from_square : 6;
 
 	/* the square the piece is moving to.                                    */
-	int to_square;
+	uint16_t to_square : 6;
 
-	/* the type of piece that is being promoted to, if any.                  */
-	int promotion_type;
+	/* the type of piece that is being promoted to, minus `KNIGHT`. only     */
+	/* meaningful for promotions, use `promotion_type` to read it.           */
+	uint16_t promotion : 2;
 
-	long long score;
+	/* one of `MOVE_NORMAL`, `MOVE_PROMOTION`, `MOVE_EN_PASSANT` or          */
+	/* `MOVE_CASTLING`.                                                      */
+	uint16_t special : 2;
 };
 
-/* create a move from the given parameters.                                  */
+_Static_assert(sizeof(struct move) == 2, "struct move must be packed into 16 bits");
+
+#define MOVE_NORMAL 0
+#define MOVE_PROMOTION 1
+#define MOVE_EN_PASSANT 2
+#define MOVE_CASTLING 3
+
+/* the null move, a1a1, which is never a legal move.                         */
+#define NO_MOVE ((struct move){ 0 })
+
+/* returns the type of piece that is being promoted to, or `NO_TYPE`.        */
+static inline int promotion_type(struct move move) {
+	return move.special == MOVE_PROMOTION ? KNIGHT + move.promotion : NO_TYPE;
+}
+
+/* check if two moves are the same.                                          */
+static inline int move_eq(struct move a, struct move b) {
+	return a.from_square == b.from_square && a.to_square == b.to_square
+		&& a.promotion == b.promotion && a.special == b.special;
+}
+
+/* create a move from the given parameters. `promotion_type` may be          */
+/* `NO_TYPE`.                                                                */
 struct move make_move(int from_square, int to_square, int promotion_type);
 
+/* create an en passant capture or castling move. `special` must be          */
+/* `MOVE_EN_PASSANT` or `MOVE_CASTLING`.                                     */
+struct move make_special_move(int from_square, int to_square, int special);
+
 /* parse a move and store the result in `move`. valid moves are the from     */
 /* square, followed by the to square, optionally followed by the promotion   */
-/* type. examples: e2e4, b1c3, e7d8q, and e1g1. returns `SUCCESS` on         */
-/* success, `FAILURE` on failure.                                            */
-int parse_move(struct move *move, const char *string);
+/* type. examples: e2e4, b1c3, e7d8q, and e1g1. the move must be legal in    */
+/* the given position, which is also used to find out if the move is an en   */
+/* passant capture or castling. returns `SUCCESS` on success, `FAILURE` on   */
+/* failure.                                                                  */
+int parse_move(const struct position *pos, struct move *move, const char *string);
+
+/* the information needed to undo a move that can't be derived from the     */
+/* move itself. `do_move` fills it in, and `undo_move` reads it back.        */
+struct undo {
+	/* hash key before the move. restoring it is cheaper than undoing the    */
+	/* incremental update.                                                   */
+	uint64_t key;
+
+	/* pawn hash key before the move.                                        */
+	uint64_t pawn_key;
+
+	/* material hash key before the move.                                    */
+	uint64_t material_key;
+
+	/* piece square sums before the move.                                    */
+	int32_t psq[2];
+
+	/* the piece on the to square before the move, may be `NO_PIECE`. pawns  */
+	/* captured en passant are not stored here, they are implied by the move */
+	/* going to the en passant square.                                       */
+	int8_t captured;
+
+	/* castling rights before the move, indexed by piece color.              */
+	int8_t castling_rights[2];
+
+	/* en passant square before the move, may be `NO_SQUARE`.                */
+	int8_t en_passant_square;
+
+	/* halfmove clock before the move.                                       */
+	int16_t halfmove_clock;
+};
 
 /* make a move on the position. the move must be pseudo-legal for the given  */
-/* position.                                                                 */
-/*                                                                           */
-/* POSSIBLE IMPROVEMENT: undo move                                           */
-/* when searching for the best move in a position, you will often need to    */
-/* make a move, examine the resulting position, and then go back to the      */
-/* previous position. instead of making a copy of the whole position, it is  */
-/* faster to go back to the previous position by undoing the move. the piece */
-/* movement itself can easily be undone my moving the piece back from the to */
-/* square to the from square. other information, such as the captured piece, */
-/* castling rights, and en passant square still need to be copied. also,     */
-/* don't forget to unpromote your pawns!                                     */
+/* position. everything `undo_move` needs to take the move back is stored in */
+/* `undo`.                                                                   */
 /*                                                                           */
 /* https://www.chessprogramming.org/Make_Move                                */
-void do_move(struct position *pos, struct move move);
+void do_move(struct position *pos, struct move move, struct undo *undo);
 
-/* check if a move is legal for the given position. the move must already be */
-/* known to be pseudo-legal.                                                 */
-/*                                                                           */
-/* POSSIBLE IMPROVEMENT: legality test                                       */
-/* for simplicity, to check if a move is legal, we generate all pseudo-legal */
-/* moves for the opponent and check if any of them can capture the king.     */
-/* this is inefficient, and duplicates work that will also be done by the    */
-/* search function. one way to improve this is to instead look from the king */
-/* to the opponent pieces. this way we don't have to generate all opponent   */
-/* moves.                                                                    */
+/* take back a move made by `do_move`. the move and the undo record must be  */
+/* the ones passed to `do_move`, and moves must be undone in reverse order.  */
+/* this is much cheaper than copying the whole position before every move.  */
 /*                                                                           */
-/* https://www.chessprogramming.org/Legal_Move                               */
-int is_legal(const struct position *pos, struct move move);
+/* https://www.chessprogramming.org/Unmake_Move                              */
+void undo_move(struct position *pos, struct move move, const struct undo *undo);
 
 #endif
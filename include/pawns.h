@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include "position.h"
+
+// Pawn structure evaluation, cached by pawn key. Pawns move in only a fraction of the moves and most
+// captures don't take a pawn, so sibling nodes nearly always share their pawn structure and the terms
+// are computed once per structure instead of once per node.
+// https://www.chessprogramming.org/Pawn_Hash_Table
+
+#define PAWN_TABLE_SIZE 16384  // Entries, a power of two. 256 KB, small enough to mostly stay in cache.
+
+typedef struct {
+	uint64_t key;
+	int32_t score;
+} t_pawn_entry;
+
+// Returns the pawn structure score from white's point of view: doubled, isolated, backward, defended
+// and passed pawns of both colors.
+int32_t evaluate_pawns(const struct position *pos);
@@ -3,45 +3,79 @@
 
 #include <stdio.h>
 #include <stdint.h>
-#include <stdbool.h>
 
 /* this struct represents the placement of pieces on a chess board, as well  */
 /* as any additional information such as side to move, castling rights, and  */
-/* possibly an en passant square. we use a square centric approach to store  */
-/* the placement of pieces because it is easy to implement, and being able   */
-/* to quickly look up what piece is on any given square is useful for move   */
-/* generation.                                                               */
+/* possibly an en passant square. pieces are stored twice: as bitboards, one */
+/* 64 bit integer per piece type and color where every bit is a square, for  */
+/* move generation, and as a mailbox indexed by square, to quickly look up   */
+/* what piece is on a given square.                                          */
 /*                                                                           */
-/* POSSIBLE IMPROVEMENT: bitboards                                           */
-/* bitboards provide a way to store the placement of pieces on a chess board */
-/* using 64 bit integers where every bit represents a square on the board.   */
-/* you might have a bitboard for each piece type and color, and then use     */
-/* bitwise operations for move generation. this is more efficient than a     */
-/* square centric approach, but it is also more complicated to implement.    */
+/* the layout is kept small, the search copies and touches positions all the */
+/* time. the mailbox and the state use single bytes. the bitboards and the   */
+/* hash key fill the first two cache lines exactly, so the ones that are     */
+/* used together share a cache line. the mailbox fills the third line. the   */
+/* fourth holds the state, then the pawn and material keys and the piece     */
+/* square sums, which only the evaluation reads.                             */
 /*                                                                           */
-/* POSSIBLE IMPROVEMENT: draw detection                                      */
-/* to keep the code simple we do not detect draws. to implement draw         */
-/* detection you need to store the number of reversible moves to keep track  */
-/* of the fifty move rule, as well as a history of board states to detect    */
-/* threefold repetition.                                                     */
+/* draws by the fifty move rule are detected with the halfmove clock, and    */
+/* repetitions with the history of hash keys below.                          */
 /*                                                                           */
 /* https://www.chessprogramming.org/Board_Representation                     */
 /* https://www.chessprogramming.org/Bitboards                                */
 struct position {
+	/* pieces indexed by color and type.                                     */
+	uint64_t bbs[2][6];
+
+	/* all pieces of each color, and all pieces of both colors.              */
+	uint64_t colors[2];
+	uint64_t occupied;
+
+	/* zobrist hash key, see `zobrist.h`. `do_move` updates it along with    */
+	/* the pieces.                                                           */
+	uint64_t key;
+
 	/* pieces indexed by square. `NO_PIECE` is used for empty squares.       */
-	int board[64];
+	int8_t board[64];
 
 	/* color of the current side to move, must be `WHITE` or `BLACK`.        */
-	int side_to_move;
+	int8_t side_to_move;
 
 	/* castling rights indexed by piece color.                               */
-	int castling_rights[2];
+	int8_t castling_rights[2];
 
 	/* en passant square, may be `NO_SQUARE`.                                */
-	int en_passant_square;
+	int8_t en_passant_square;
 
-	uint64_t bbs[2][6];
-	bool game_over;
+	/* the number of moves since the last capture or pawn move, in plies.    */
+	int16_t halfmove_clock;
+
+	/* zobrist hash key of only the pawns, for the pawn hash table. see      */
+	/* `zobrist_pawn_key`.                                                   */
+	uint64_t pawn_key;
+
+	/* zobrist hash key of only the number of pieces of each kind, for the   */
+	/* material hash table. see `zobrist_material_key`.                      */
+	uint64_t material_key;
+
+	/* the sum of the middle game and end game values of all pieces, from    */
+	/* white's point of view, indexed by `PSQ_MG` and `PSQ_EG`. see `psq.h`. */
+	int32_t psq[2];
+};
+
+_Static_assert(sizeof(struct position) <= 256, "struct position should fit in four cache lines");
+
+/* the largest number of keys a history holds.                               */
+#define MAX_HISTORY 1024
+
+/* the hash keys of the positions that led to the current position, oldest   */
+/* first, not including the current position itself. positions before the    */
+/* last capture or pawn move can never come back, so those may be left out.  */
+/*                                                                           */
+/* https://www.chessprogramming.org/Repetitions                              */
+struct history {
+	uint64_t keys[MAX_HISTORY];
+	int count;
 };
 
 /* print out information about the position. useful for debugging.           */
@@ -53,4 +87,24 @@ void print_position(const struct position *pos, FILE *stream);
 /* https://www.chessprogramming.org/Forsyth-Edwards_Notation                 */
 int parse_position(struct position *pos, const char *fen);
 
+/* check if the position occurred before, according to the history. only     */
+/* every other position since the last capture or pawn move can be the same  */
+/* position, with the same side to move, so only those are compared.         */
+static inline int is_repetition(const struct position *pos, const struct history *history) {
+	int distance;
+
+	for (distance = 4; distance <= pos->halfmove_clock && distance <= history->count; distance += 2) {
+		if (history->keys[history->count - distance] == pos->key) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* check if the game is drawn by the fifty move rule.                        */
+static inline int is_fifty_move_draw(const struct position *pos) {
+	return pos->halfmove_clock >= 100;
+}
+
 #endif
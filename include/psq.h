@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include "position.h"
+
+// Material plus piece square table value of every piece on every square, in the middle game and in the
+// end game, from white's point of view. The position keeps the sum of both over all its pieces up to
+// date as pieces move, so the evaluation only has to blend two numbers by game phase.
+// https://www.chessprogramming.org/Tapered_Eval
+// https://www.chessprogramming.org/Incremental_Updates
+
+#define PSQ_MG 0
+#define PSQ_EG 1
+
+// Indexed by piece, square and PSQ_MG or PSQ_EG, so both values of a piece on a square are one load
+extern int32_t g_psq[12][64][2];
+
+// Fills in the table, must be called once before any position is parsed or any move is made
+void init_psq(void);
+
+// Sums the values of all pieces of the position from scratch. pos->psq should always be equal to this,
+// it is only computed this way when the position is set up, and to check the incremental updates.
+void psq_compute(const struct position *pos, int32_t psq[2]);
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "move.h"
+
+// Transposition table: search results by position key, shared by every iteration, by the search on the
+// opponent's time and by the real search after it.
+// https://www.chessprogramming.org/Transposition_Table
+
+#define TT_DEFAULT_MB 16
+#define TT_MAX_MB 65536
+
+// What the stored score says about the real score of the position
+#define TT_NONE 0   // Empty entry
+#define TT_UPPER 1  // All moves failed low, the real score is at most this
+#define TT_LOWER 2  // A move failed high, the real score is at least this
+#define TT_EXACT 3
+
+#define TT_BUCKET_SIZE 4
+
+// The key word is stored xored with the data word. If two threads write the same entry at once and the
+// words end up from different writes, the key no longer matches and the entry reads as a miss instead of
+// handing out another position's move and score.
+// https://www.chessprogramming.org/Shared_Hash_Table#Xor
+typedef struct {
+	uint64_t key;
+	uint64_t data;
+} t_tt_entry;
+
+// A bucket is one cache line, so a probe costs a single miss
+typedef struct {
+	t_tt_entry entries[TT_BUCKET_SIZE];
+} __attribute__((aligned(64))) t_tt_bucket;
+
+_Static_assert(sizeof(t_tt_bucket) == 64, "a bucket should fill one cache line");
+
+#define TT_FILE_MAGIC "CMTTHASH"
+#define TT_FILE_VERSION 1
+#define TT_FILE_HEADER_SIZE 4096  // A whole page, so the buckets after it stay page aligned
+
+// The start of a hash file. Everything before `age` must match for the entries to be used: the entry
+// layout, the table size and the zobrist numbers the keys were computed with.
+typedef struct {
+	char magic[8];
+	uint32_t version;            // Bumped whenever the entry layout or the key computation changes
+	uint32_t bucket_size;
+	uint64_t bucket_count;
+	uint64_t zobrist_checksum;
+	uint8_t age;                 // Age of the last search, so entries of later games are younger
+} t_tt_file_header;
+
+_Static_assert(sizeof(t_tt_file_header) <= TT_FILE_HEADER_SIZE, "the hash file header should fit in its page");
+
+typedef struct {
+	t_tt_bucket *buckets;
+	size_t bucket_count;        // Always a power of two
+	t_tt_file_header *header;   // Start of the mapping when the table is in a hash file, NULL otherwise
+	size_t mapped;              // Size of the mapping
+	uint8_t age;                // Bumped every search, so entries of earlier searches get replaced first
+} t_tt;
+
+// An entry unpacked from its data word
+typedef struct {
+	struct move move;
+	int32_t score;
+	int depth;
+	int bound;
+} t_tt_data;
+
+extern t_tt g_tt;
+
+static inline t_tt_bucket *tt_bucket(uint64_t key) {
+	return &g_tt.buckets[key & (g_tt.bucket_count - 1)];
+}
+
+// Starts loading the bucket of a position that is about to be probed, so the cache miss overlaps other work
+static inline void tt_prefetch(uint64_t key) {
+	__builtin_prefetch(tt_bucket(key));
+}
+
+// Replaces the table by an empty one of at most the given size, in the hash file if one is set. Memory
+// is aligned to 2 MB and the kernel is asked to back it with huge pages, probes hit random buckets and
+// would mostly miss the TLB with 4 KB pages. Returns false and keeps the current table if the memory
+// can't be allocated.
+bool tt_resize(size_t megabytes);
+
+// Moves the table into the given file, keeping its size, or back into memory if the path is empty. The
+// file is mapped shared, so entries written by one game are there for the next game without loading
+// anything, pages are read in as probes touch them. A file with a mismatching header is wiped. Returns
+// false and keeps the current table if the file can't be used.
+bool tt_set_file(const char *path);
+
+// Empties the table
+void tt_clear(void);
+
+// Starts a new age, called at the start of every search
+void tt_new_search(void);
+
+// How many of a thousand entries are used by the current search, for `info hashfull`
+int tt_hashfull(void);
+
+// Looks up the position, returns false if it isn't stored
+bool tt_probe(uint64_t key, t_tt_data *data);
+
+// Stores a search result, replacing the entry of the same position or the least useful one in its bucket. A
+// deeper entry of the same position from the current search is kept instead. Depths are kept in 8 bits, the
+// search never goes past MAX_PLY.
+void tt_store(uint64_t key, struct move move, int32_t score, int depth, int bound);
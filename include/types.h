@@ -63,4 +63,17 @@
 /* returns the rank from the perspective of the given color.                 */
 #define RELATIVE(rank, color) ((color) == WHITE ? (rank) : 7 - (rank))
 
+/* returns the square offset of one step forward for the given color.        */
+#define FORWARD(color) ((color) == WHITE ? 8 : -8)
+
+/* call `function` with `color` appended to its arguments as a constant. hot */
+/* functions that take the color this way are marked `ALWAYS_INLINE`, so the */
+/* compiler generates a white and a black copy of them in which everything   */
+/* that depends on the color, like pawn directions and relative ranks, is    */
+/* folded into constants. the color is then only branched on once, here.     */
+#define COLOR_DISPATCH(color, function, ...) \
+	((color) == WHITE ? function(__VA_ARGS__, WHITE) : function(__VA_ARGS__, BLACK))
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
 #endif
@@ -2,12 +2,16 @@
 #define UCI_H
 
 #include <stdio.h>
+#include <stdbool.h>
 #include "position.h"
 #include "move.h"
 
 char *get_line(FILE *stream);
 char *get_token(char *string, char *store);
-void uci_position(struct position *pos, char *token, char *store, struct move *last_move);
+/* set up the position from the arguments of a `position` command, and the   */
+/* history of the positions since the last irreversible move. returns true   */
+/* if the game is over, when the side to move has no legal moves.            */
+bool uci_position(struct position *pos, struct history *history, char *token, char *store, struct move *last_move);
 
 /* Universal Chess Interface is a protocol that chess GUIs use to talk to    */
 /* chess engines. this function is called from `main` and handles            */
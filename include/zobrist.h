@@ -0,0 +1,66 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include "attack.h"
+#include "position.h"
+#include "types.h"
+
+#include <stdint.h>
+
+/* zobrist hashing maps a position to a 64 bit key by xoring together one    */
+/* random number for every piece on its square, one for the castling rights, */
+/* one for the file of the en passant square, and one if black is to move.   */
+/* because xor is its own inverse, making a move only has to xor out the     */
+/* numbers of what changed and xor in the new ones, which is how `do_move`   */
+/* keeps `pos->key` up to date. equal positions always get equal keys, and   */
+/* different positions almost never do, so the key can stand in for the      */
+/* position in hash tables and when looking for repetitions.                 */
+/*                                                                           */
+/* https://www.chessprogramming.org/Zobrist_Hashing                          */
+
+/* indexed by piece and square.                                              */
+extern uint64_t zobrist_pieces[12][64];
+
+/* indexed by `CASTLING_INDEX` of the castling rights of both colors.        */
+extern uint64_t zobrist_castling[16];
+
+/* indexed by the file of the en passant square.                             */
+extern uint64_t zobrist_en_passant[8];
+
+/* xored in when black is to move.                                           */
+extern uint64_t zobrist_side;
+
+/* returns the castling rights of both colors packed into 4 bits.            */
+#define CASTLING_INDEX(rights) ((rights)[WHITE] | (rights)[BLACK] << 2)
+
+/* check if the en passant square counts for the key. it only does if a      */
+/* pawn of the side to move attacks it, otherwise the position is the same   */
+/* as without it, and must get the same key to be found as a repetition.     */
+static inline int en_passant_capturable(const struct position *pos) {
+	return pos->en_passant_square != NO_SQUARE
+		&& (pawn_attacks[1 - pos->side_to_move][pos->en_passant_square] & pos->bbs[pos->side_to_move][PAWN]) != 0;
+}
+
+/* initialize the random numbers. this must be called once before any        */
+/* position is parsed or any move is made.                                   */
+void init_zobrist(void);
+
+/* compute the key of the position from scratch. `pos->key` should always be */
+/* equal to this, it is only computed this way when the position is set up,  */
+/* and to check the incremental updates.                                     */
+uint64_t zobrist_key(const struct position *pos);
+
+/* compute the key of only the pawns of both colors from scratch, with the   */
+/* same numbers as `zobrist_key`. pawn structure changes far less often than */
+/* the rest of the position, so evaluation terms that only depend on the     */
+/* pawns are cached by this key. `pos->pawn_key` should always be equal to   */
+/* this.                                                                     */
+uint64_t zobrist_pawn_key(const struct position *pos);
+
+/* compute the key of the material on the board from scratch. the square     */
+/* index of the piece numbers is used as a count instead: the number for     */
+/* the nth piece of a kind is xored in, so the key only changes on captures  */
+/* and promotions. `pos->material_key` should always be equal to this.       */
+uint64_t zobrist_material_key(const struct position *pos);
+
+#endif
@@ -0,0 +1,351 @@
+#include "attack.h"
+#include "types.h"
+
+#include <stddef.h>
+
+uint64_t pawn_attacks[2][64];
+uint64_t knight_attacks[64];
+uint64_t king_attacks[64];
+struct magic rook_magics[64];
+struct magic bishop_magics[64];
+uint64_t between_bb[64][64];
+uint64_t line_bb[64][64];
+
+static uint64_t rook_table[102400];
+static uint64_t bishop_table[5248];
+
+static const int rook_directions[4][2] = { { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 } };
+static const int bishop_directions[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+
+#ifdef __AVX2__
+#define FILE_A_BB 0x0101010101010101ULL
+#define FILE_H_BB 0x8080808080808080ULL
+
+/* the fill directions as square offsets, one per lane: north, east, north   */
+/* east and north west shift up, the opposite directions shift down by the   */
+/* same amount. the wrap masks remove the squares a shift by that offset     */
+/* would carry over to the other side of the board. the first two lanes are  */
+/* orthogonal, the last two diagonal.                                        */
+static const uint64_t fill_shifts[4] = { 8, 1, 9, 7 };
+static const uint64_t fill_up_wraps[4] = { ~0ULL, ~FILE_A_BB, ~FILE_A_BB, ~FILE_H_BB };
+static const uint64_t fill_down_wraps[4] = { ~0ULL, ~FILE_H_BB, ~FILE_H_BB, ~FILE_A_BB };
+#endif
+
+/* returns the bitboard of the square offset from the given square, or an    */
+/* empty bitboard if that square is off the board.                           */
+static uint64_t offset_bb(int square, int file_offset, int rank_offset) {
+	int file = FILE(square) + file_offset;
+	int rank = RANK(square) + rank_offset;
+
+	if (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+		return 1ULL << SQUARE(file, rank);
+	} else {
+		return 0;
+	}
+}
+
+/* compute the attacks of a slider the slow way, by walking every direction  */
+/* until we run into a piece or off the board.                               */
+static uint64_t slider_attacks(int square, uint64_t occupied, const int directions[4][2]) {
+	uint64_t attacks = 0;
+	int index;
+
+	for (index = 0; index < 4; index++) {
+		int file = FILE(square) + directions[index][0];
+		int rank = RANK(square) + directions[index][1];
+
+		while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+			attacks |= 1ULL << SQUARE(file, rank);
+
+			if (occupied & (1ULL << SQUARE(file, rank))) {
+				break;
+			}
+
+			file += directions[index][0];
+			rank += directions[index][1];
+		}
+	}
+
+	return attacks;
+}
+
+/* compute the blocker mask of a slider. pieces on the last square of a ray  */
+/* never change the attack set, so those squares are left out.               */
+static uint64_t slider_mask(int square, const int directions[4][2]) {
+	uint64_t mask = 0;
+	int index;
+
+	for (index = 0; index < 4; index++) {
+		int file = FILE(square) + directions[index][0];
+		int rank = RANK(square) + directions[index][1];
+		int next_file = file + directions[index][0];
+		int next_rank = rank + directions[index][1];
+
+		while (next_file >= 0 && next_file < 8 && next_rank >= 0 && next_rank < 8) {
+			mask |= 1ULL << SQUARE(file, rank);
+			file = next_file;
+			rank = next_rank;
+			next_file += directions[index][0];
+			next_rank += directions[index][1];
+		}
+	}
+
+	return mask;
+}
+
+/* xorshift pseudo random number generator. the seed is fixed so the same   */
+/* magics are found every time the engine starts.                            */
+static uint64_t random_u64(uint64_t *state) {
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+
+	return *state * 2685821657736338717ULL;
+}
+
+#ifndef USE_PEXT
+/* find a magic number for the square by trial and error. candidates with    */
+/* few bits set tend to work well, so we and together three random numbers. */
+static void find_magic(struct magic *m, uint64_t *table, const uint64_t *occupancies, const uint64_t *attacks, int size) {
+	static uint64_t state = 0x9E3779B97F4A7C15ULL;
+	static int epoch[4096];
+	static int current = 0;
+	int index;
+
+	for (;;) {
+		m->magic = random_u64(&state) & random_u64(&state) & random_u64(&state);
+
+		if (__builtin_popcountll((m->mask * m->magic) >> 56) < 6) {
+			continue;
+		}
+
+		/* `epoch` tells which table entries were written by this attempt,   */
+		/* so the table doesn't have to be cleared between attempts.         */
+		current++;
+
+		for (index = 0; index < size; index++) {
+			size_t hash = magic_index(m, occupancies[index]);
+
+			if (epoch[hash] < current) {
+				epoch[hash] = current;
+				table[hash] = attacks[index];
+			} else if (table[hash] != attacks[index]) {
+				break;
+			}
+		}
+
+		if (index == size) {
+			return;
+		}
+	}
+}
+#endif
+
+/* fill the attack table of every square for one type of slider.            */
+static void init_magics(struct magic *magics, uint64_t *table, const int directions[4][2]) {
+	static uint64_t occupancies[4096];
+	static uint64_t attacks[4096];
+	int square;
+
+	for (square = 0; square < 64; square++) {
+		struct magic *m = &magics[square];
+		uint64_t subset = 0;
+		int bits;
+		int size = 0;
+
+		m->mask = slider_mask(square, directions);
+		m->attacks = table;
+		bits = __builtin_popcountll(m->mask);
+		m->shift = 64 - bits;
+
+		/* enumerate all subsets of the mask using the carry-rippler trick.  */
+		do {
+			occupancies[size] = subset;
+			attacks[size] = slider_attacks(square, subset, directions);
+			size++;
+			subset = (subset - m->mask) & m->mask;
+		} while (subset);
+
+#ifdef USE_PEXT
+		/* pext maps every subset to a unique index, nothing to search for.  */
+		m->magic = 0;
+
+		for (int index = 0; index < size; index++) {
+			table[magic_index(m, occupancies[index])] = attacks[index];
+		}
+#else
+		find_magic(m, table, occupancies, attacks, size);
+#endif
+
+		table += 1ULL << bits;
+	}
+}
+
+void init_attacks(void) {
+	int square;
+
+	for (square = 0; square < 64; square++) {
+		pawn_attacks[WHITE][square] = offset_bb(square, -1, 1) | offset_bb(square, 1, 1);
+		pawn_attacks[BLACK][square] = offset_bb(square, -1, -1) | offset_bb(square, 1, -1);
+
+		knight_attacks[square] = offset_bb(square, -1, -2) | offset_bb(square, 1, -2)
+			| offset_bb(square, -2, -1) | offset_bb(square, 2, -1)
+			| offset_bb(square, -2, 1) | offset_bb(square, 2, 1)
+			| offset_bb(square, -1, 2) | offset_bb(square, 1, 2);
+
+		king_attacks[square] = offset_bb(square, -1, -1) | offset_bb(square, 0, -1)
+			| offset_bb(square, 1, -1) | offset_bb(square, -1, 0)
+			| offset_bb(square, 1, 0) | offset_bb(square, -1, 1)
+			| offset_bb(square, 0, 1) | offset_bb(square, 1, 1);
+	}
+
+	init_magics(rook_magics, rook_table, rook_directions);
+	init_magics(bishop_magics, bishop_table, bishop_directions);
+
+	/* lines and the squares in between follow from the empty board slider   */
+	/* attacks, so they can only be computed after the magics.               */
+	for (square = 0; square < 64; square++) {
+		int other;
+
+		for (other = 0; other < 64; other++) {
+			uint64_t square_bb = 1ULL << square;
+			uint64_t other_bb = 1ULL << other;
+
+			if (rook_attacks(square, 0) & other_bb) {
+				line_bb[square][other] = (rook_attacks(square, 0) & rook_attacks(other, 0)) | square_bb | other_bb;
+				between_bb[square][other] = rook_attacks(square, other_bb) & rook_attacks(other, square_bb);
+			} else if (bishop_attacks(square, 0) & other_bb) {
+				line_bb[square][other] = (bishop_attacks(square, 0) & bishop_attacks(other, 0)) | square_bb | other_bb;
+				between_bb[square][other] = bishop_attacks(square, other_bb) & bishop_attacks(other, square_bb);
+			}
+		}
+	}
+}
+
+/* check every occupancy of the blocker mask of every square.               */
+static int verify_magics(const struct magic *magics, const int directions[4][2]) {
+	int square;
+
+	for (square = 0; square < 64; square++) {
+		const struct magic *m = &magics[square];
+		uint64_t subset = 0;
+
+		do {
+			uint64_t attacks = slider_attacks(square, subset, directions);
+
+			if (m->attacks[magic_index(m, subset)] != attacks) {
+				return FAILURE;
+			}
+
+			/* pieces outside the mask must not change the result either.    */
+			if (m->attacks[magic_index(m, subset | ~m->mask)] != attacks) {
+				return FAILURE;
+			}
+
+			subset = (subset - m->mask) & m->mask;
+		} while (subset);
+	}
+
+	return SUCCESS;
+}
+
+/* check the fills against the table lookups, piece by piece.                */
+static int verify_fill(void) {
+	uint64_t state = 0x2545F4914F6CDD1DULL;
+	int index;
+
+	for (index = 0; index < 100000; index++) {
+		/* sparse random boards, with some of the pieces on them sliders.    */
+		uint64_t occupied = random_u64(&state) & random_u64(&state);
+		uint64_t orthogonal = occupied & random_u64(&state) & random_u64(&state);
+		uint64_t diagonal = occupied & random_u64(&state) & random_u64(&state);
+		uint64_t expected_orthogonal = 0;
+		uint64_t expected_diagonal = 0;
+		uint64_t orthogonal_attacks;
+		uint64_t diagonal_attacks;
+		uint64_t pieces;
+
+		for (pieces = orthogonal; pieces; pieces &= pieces - 1) {
+			expected_orthogonal |= rook_attacks(__builtin_ctzll(pieces), occupied);
+		}
+
+		for (pieces = diagonal; pieces; pieces &= pieces - 1) {
+			expected_diagonal |= bishop_attacks(__builtin_ctzll(pieces), occupied);
+		}
+
+		slider_fill(orthogonal, diagonal, occupied, &orthogonal_attacks, &diagonal_attacks);
+
+		if (orthogonal_attacks != expected_orthogonal || diagonal_attacks != expected_diagonal) {
+			return FAILURE;
+		}
+	}
+
+	return SUCCESS;
+}
+
+int verify_attacks(void) {
+	if (verify_magics(rook_magics, rook_directions) != SUCCESS) {
+		return FAILURE;
+	}
+
+	if (verify_magics(bishop_magics, bishop_directions) != SUCCESS) {
+		return FAILURE;
+	}
+
+	return verify_fill();
+}
+
+#ifdef __AVX2__
+void slider_fill(uint64_t orthogonal, uint64_t diagonal, uint64_t occupied, uint64_t *orthogonal_attacks, uint64_t *diagonal_attacks) {
+	const __m256i shift = _mm256_loadu_si256((const __m256i *) fill_shifts);
+	const __m256i up_wrap = _mm256_loadu_si256((const __m256i *) fill_up_wraps);
+	const __m256i down_wrap = _mm256_loadu_si256((const __m256i *) fill_down_wraps);
+	const __m256i empty = _mm256_set1_epi64x(~occupied);
+	__m256i up_gen = _mm256_setr_epi64x(orthogonal, orthogonal, diagonal, diagonal);
+	__m256i down_gen = up_gen;
+	__m256i up_pro = _mm256_and_si256(empty, up_wrap);
+	__m256i down_pro = _mm256_and_si256(empty, down_wrap);
+	__m256i step = shift;
+	__m256i attacks;
+	uint64_t lanes[4];
+	int index;
+
+	/* smear the pieces over the empty squares 1, 2 and then 4 steps at a    */
+	/* time. `pro` holds the squares that can be passed through for the      */
+	/* current step length, which covers the whole ray in three rounds.      */
+	for (index = 0; index < 3; index++) {
+		up_gen = _mm256_or_si256(up_gen, _mm256_and_si256(up_pro, _mm256_sllv_epi64(up_gen, step)));
+		down_gen = _mm256_or_si256(down_gen, _mm256_and_si256(down_pro, _mm256_srlv_epi64(down_gen, step)));
+
+		if (index < 2) {
+			up_pro = _mm256_and_si256(up_pro, _mm256_sllv_epi64(up_pro, step));
+			down_pro = _mm256_and_si256(down_pro, _mm256_srlv_epi64(down_pro, step));
+			step = _mm256_add_epi64(step, step);
+		}
+	}
+
+	/* the fill stops on the blocker, one more step attacks it.              */
+	attacks = _mm256_or_si256(
+		_mm256_and_si256(_mm256_sllv_epi64(up_gen, shift), up_wrap),
+		_mm256_and_si256(_mm256_srlv_epi64(down_gen, shift), down_wrap));
+	_mm256_storeu_si256((__m256i *) lanes, attacks);
+
+	*orthogonal_attacks = lanes[0] | lanes[1];
+	*diagonal_attacks = lanes[2] | lanes[3];
+}
+#else
+void slider_fill(uint64_t orthogonal, uint64_t diagonal, uint64_t occupied, uint64_t *orthogonal_attacks, uint64_t *diagonal_attacks) {
+	/* a scalar fill has to run the eight directions one after the other,    */
+	/* which is several times slower than looking up the pieces one by one.  */
+	*orthogonal_attacks = 0;
+	*diagonal_attacks = 0;
+
+	for (; orthogonal; orthogonal &= orthogonal - 1) {
+		*orthogonal_attacks |= rook_attacks(__builtin_ctzll(orthogonal), occupied);
+	}
+
+	for (; diagonal; diagonal &= diagonal - 1) {
+		*diagonal_attacks |= bishop_attacks(__builtin_ctzll(diagonal), occupied);
+	}
+}
+#endif
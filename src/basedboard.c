@@ -1,10 +1,13 @@
 #include "basedboard.h"
+#include "zobrist.h"
+#include "psq.h"
 
 void set_bbs(struct position *pos) {
 	for (int c = 0; c < 2; c++) {
 		for (int t = 0; t < 6; t++) {
 			pos->bbs[c][t] = 0ULL;
 		}
+		pos->colors[c] = 0ULL;
 	}
 
 	for (int index = 0; index < 64; index++) {
@@ -18,5 +21,12 @@ void set_bbs(struct position *pos) {
 		int type = TYPE(piece);
 
 		pos->bbs[color][type] |= 1ULL << index;
+		pos->colors[color] |= 1ULL << index;
 	}
+
+	pos->occupied = pos->colors[WHITE] | pos->colors[BLACK];
+	pos->key = zobrist_key(pos);
+	pos->pawn_key = zobrist_pawn_key(pos);
+	pos->material_key = zobrist_material_key(pos);
+	psq_compute(pos, pos->psq);
 }
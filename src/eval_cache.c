@@ -0,0 +1,8 @@
+#include "eval_cache.h"
+
+t_eval_cache g_eval_cache;
+
+void eval_cache_new_search(void) {
+	g_eval_cache.hits = 0;
+	g_eval_cache.misses = 0;
+}
@@ -1,2 +0,0 @@
-#include "evaluate.h"
-#include "types.h"
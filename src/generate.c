@@ -1,225 +1,596 @@
 #include "generate.h"
+#include "attack.h"
+#include "basedboard.h"
 #include "types.h"
 
-/* add the file and rank offset to the square. returns `NO_SQUARE` if the    */
-/* resulting square is off the board.                                        */
-static int add_offset(int square, int file_offset, int rank_offset) {
-	int file = FILE(square) + file_offset;
-	int rank = RANK(square) + rank_offset;
+/* add a move from `from_square` to every square in `targets`. returns the  */
+/* number of moves generated.                                                */
+static size_t add_moves(struct move *moves, int from_square, uint64_t targets) {
+	size_t count = 0;
 
-	if (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
-		return SQUARE(file, rank);
-	} else {
-		return NO_SQUARE;
+	while (targets) {
+		moves[count++] = make_move(from_square, bb_pop_lsb(&targets), NO_TYPE);
 	}
+
+	return count;
 }
 
-/* generate a pawn move, taking into account promotions. returns the number  */
-/* of moves generated.                                                       */
-static size_t generate_pawn_move(const struct position *pos, struct move *moves, int from_square, int to_square) {
+/* add a pawn move to every square in `targets`, where the from square is    */
+/* `offset` squares behind the to square. moves to the last rank are         */
+/* expanded into all four promotions. pawns in `pinned` may only move along  */
+/* the line through the king. returns the number of moves generated.         */
+static ALWAYS_INLINE size_t add_pawn_moves(struct move *moves, uint64_t targets, int offset, uint64_t pinned, int king_square, int side) {
+	uint64_t last_rank = RANK_BB(RELATIVE(RANK_8, side));
 	size_t count = 0;
 
-	if (RANK(to_square) == RELATIVE(RANK_8, pos->side_to_move)) {
-		moves[count++] = make_move(from_square, to_square, KNIGHT);
-		moves[count++] = make_move(from_square, to_square, BISHOP);
-		moves[count++] = make_move(from_square, to_square, ROOK);
-		moves[count++] = make_move(from_square, to_square, QUEEN);
-	} else {
-		moves[count++] = make_move(from_square, to_square, NO_TYPE);
+	while (targets) {
+		int to_square = bb_pop_lsb(&targets);
+		int from_square = to_square - offset;
+
+		if ((pinned & SQUARE_BB(from_square)) && !(line_bb[king_square][from_square] & SQUARE_BB(to_square))) {
+			continue;
+		}
+
+		if (SQUARE_BB(to_square) & last_rank) {
+			moves[count++] = make_move(from_square, to_square, KNIGHT);
+			moves[count++] = make_move(from_square, to_square, BISHOP);
+			moves[count++] = make_move(from_square, to_square, ROOK);
+			moves[count++] = make_move(from_square, to_square, QUEEN);
+		} else {
+			moves[count++] = make_move(from_square, to_square, NO_TYPE);
+		}
 	}
 
 	return count;
 }
 
-/* generate a pawn capture, taking into account promotions. this function    */
-/* makes sure that the destination square is on the board, and that it       */
-/* contains an opponent piece or is the en passant square. returns the       */
-/* number of moves generated.                                                */
-static size_t generate_pawn_capture(const struct position *pos, struct move *moves, int from_square, int file_offset, int rank_offset) {
-	int to_square = add_offset(from_square, file_offset, rank_offset);
+uint64_t attackers_to(const struct position *pos, int square, uint64_t occupied) {
+	uint64_t bishops = pos->bbs[WHITE][BISHOP] | pos->bbs[BLACK][BISHOP] | pos->bbs[WHITE][QUEEN] | pos->bbs[BLACK][QUEEN];
+	uint64_t rooks = pos->bbs[WHITE][ROOK] | pos->bbs[BLACK][ROOK] | pos->bbs[WHITE][QUEEN] | pos->bbs[BLACK][QUEEN];
 
-	if (to_square != NO_SQUARE) {
-		int piece = pos->board[to_square];
-		int capture = piece != NO_PIECE && COLOR(piece) != pos->side_to_move;
+	return (pawn_attacks[BLACK][square] & pos->bbs[WHITE][PAWN])
+		| (pawn_attacks[WHITE][square] & pos->bbs[BLACK][PAWN])
+		| (knight_attacks[square] & (pos->bbs[WHITE][KNIGHT] | pos->bbs[BLACK][KNIGHT]))
+		| (king_attacks[square] & (pos->bbs[WHITE][KING] | pos->bbs[BLACK][KING]))
+		| (bishop_attacks(square, occupied) & bishops)
+		| (rook_attacks(square, occupied) & rooks);
+}
+
+int is_square_attacked(const struct position *pos, int square, int color, uint64_t occupied) {
+	return (attackers_to(pos, square, occupied) & color_bb(pos, color)) != 0;
+}
+
+/* returns the pieces in `blockers` that are the only piece between the     */
+/* king on `king_square` and a slider of the given color looking at it.     */
+static uint64_t slider_blockers(const struct position *pos, int color, int king_square, uint64_t blockers, uint64_t occupied) {
+	uint64_t snipers = (rook_attacks(king_square, 0) & (pos->bbs[color][ROOK] | pos->bbs[color][QUEEN]))
+		| (bishop_attacks(king_square, 0) & (pos->bbs[color][BISHOP] | pos->bbs[color][QUEEN]));
+	uint64_t result = 0;
+
+	while (snipers) {
+		uint64_t between = between_bb[king_square][bb_pop_lsb(&snipers)] & occupied;
 
-		if (capture || to_square == pos->en_passant_square) {
-			return generate_pawn_move(pos, moves, from_square, to_square);
+		if (bb_count(between) == 1) {
+			result |= between & blockers;
 		}
 	}
 
-	return 0;
+	return result;
+}
+
+uint64_t pinned_pieces(const struct position *pos, int color, int king_square, uint64_t occupied) {
+	/* a piece is pinned if it is the only piece between the king and an     */
+	/* enemy slider looking at the king through it.                          */
+	return slider_blockers(pos, 1 - color, king_square, color_bb(pos, color), occupied);
 }
 
-/* generate a simple, non-sliding move. this function makes sure that the    */
-/* destination square is on the board, and that it is empty or contains an   */
-/* opponent piece. returns the number of moves generated.                    */
-static size_t generate_simple_move(const struct position *pos, struct move *moves, int from_square, int file_offset, int rank_offset) {
+uint64_t discovered_check_candidates(const struct position *pos, int color, uint64_t occupied) {
+	int king_square = bb_lsb(pos->bbs[1 - color][KING]);
+
+	/* the same as a pin, but with our own slider behind our own piece.      */
+	return slider_blockers(pos, color, king_square, color_bb(pos, color), occupied);
+}
+
+void init_check_info(const struct position *pos, struct check_info *info) {
+	int side = pos->side_to_move;
+	uint64_t occupied = pos->occupied;
+	int king_square = bb_lsb(pos->bbs[1 - side][KING]);
+
+	info->king_square = king_square;
+	info->discovered = discovered_check_candidates(pos, side, occupied);
+	info->check_squares[PAWN] = pawn_attacks[1 - side][king_square];
+	info->check_squares[KNIGHT] = knight_attacks[king_square];
+	info->check_squares[BISHOP] = bishop_attacks(king_square, occupied);
+	info->check_squares[ROOK] = rook_attacks(king_square, occupied);
+	info->check_squares[QUEEN] = info->check_squares[BISHOP] | info->check_squares[ROOK];
+	info->check_squares[KING] = 0;
+}
+
+int gives_check(const struct position *pos, struct move move, const struct check_info *info) {
+	int side = pos->side_to_move;
+	int type = TYPE(pos->board[move.from_square]);
+	uint64_t occupied;
+	uint64_t sliders;
+
+	/* direct check.                                                         */
+	if (move.special != MOVE_PROMOTION && (info->check_squares[type] & SQUARE_BB(move.to_square))) {
+		return 1;
+	}
+
+	/* discovered check, unless the piece stays on the line.                 */
+	if ((info->discovered & SQUARE_BB(move.from_square))
+			&& !(line_bb[info->king_square][move.from_square] & SQUARE_BB(move.to_square))) {
+		return 1;
+	}
+
+	switch (move.special) {
+	case MOVE_PROMOTION:
+		/* the pawn may have been standing between the new piece and the     */
+		/* king, so look with the pawn removed.                              */
+		occupied = pos->occupied ^ SQUARE_BB(move.from_square);
+
+		switch (promotion_type(move)) {
+		case KNIGHT: return (knight_attacks[move.to_square] & SQUARE_BB(info->king_square)) != 0;
+		case BISHOP: return (bishop_attacks(move.to_square, occupied) & SQUARE_BB(info->king_square)) != 0;
+		case ROOK: return (rook_attacks(move.to_square, occupied) & SQUARE_BB(info->king_square)) != 0;
+		default: return (queen_attacks(move.to_square, occupied) & SQUARE_BB(info->king_square)) != 0;
+		}
+	case MOVE_EN_PASSANT:
+		/* removing the captured pawn can uncover a slider as well.          */
+		occupied = pos->occupied
+			^ SQUARE_BB(move.from_square) ^ SQUARE_BB(SQUARE(FILE(move.to_square), RANK(move.from_square)))
+			^ SQUARE_BB(move.to_square);
+		sliders = (rook_attacks(info->king_square, occupied) & (pos->bbs[side][ROOK] | pos->bbs[side][QUEEN]))
+			| (bishop_attacks(info->king_square, occupied) & (pos->bbs[side][BISHOP] | pos->bbs[side][QUEEN]));
+
+		return sliders != 0;
+	case MOVE_CASTLING: {
+		/* only the rook can give check, from the square the king passed.    */
+		int rank = RELATIVE(RANK_1, side);
+		int rook_from = SQUARE(FILE(move.to_square) == FILE_G ? FILE_H : FILE_A, rank);
+		int rook_to = SQUARE(FILE(move.to_square) == FILE_G ? FILE_F : FILE_D, rank);
+
+		occupied = pos->occupied
+			^ SQUARE_BB(move.from_square) ^ SQUARE_BB(rook_from) ^ SQUARE_BB(move.to_square) ^ SQUARE_BB(rook_to);
+
+		return (rook_attacks(rook_to, occupied) & SQUARE_BB(info->king_square)) != 0;
+	}
+	default:
+		return 0;
+	}
+}
+
+/* generate the en passant capture from `from_square`, if it is legal. the   */
+/* capture removes two pawns from the same rank at once, which can uncover   */
+/* an attack on the king that the pin mask doesn't see, so we simply check  */
+/* the king with the occupancy after the capture. returns the number of      */
+/* moves generated.                                                          */
+static ALWAYS_INLINE size_t generate_en_passant(const struct position *pos, struct move *moves, int from_square, int king_square, uint64_t occupied, int side) {
+	int to_square = pos->en_passant_square;
+	int captured_square = to_square - FORWARD(side);
+	int enemy = 1 - side;
+	uint64_t after = (occupied ^ SQUARE_BB(from_square) ^ SQUARE_BB(captured_square)) | SQUARE_BB(to_square);
+	uint64_t attackers = attackers_to(pos, king_square, after) & color_bb(pos, enemy);
+
+	/* the captured pawn is still in its bitboard, but it no longer attacks. */
+	if (attackers & ~SQUARE_BB(captured_square)) {
+		return 0;
+	}
+
+	moves[0] = make_special_move(from_square, to_square, MOVE_EN_PASSANT);
+
+	return 1;
+}
+
+/* generate the king moves to squares in `targets` that are not attacked.    */
+/* the king is removed from the occupancy, otherwise it would hide the       */
+/* squares behind it from the slider it is running from. squares in          */
+/* `enemy_attacks` are known to be attacked and skipped right away, it may   */
+/* be empty. returns the number of moves generated.                          */
+static ALWAYS_INLINE size_t generate_king_moves(const struct position *pos, struct move *moves, uint64_t targets, int king_square, uint64_t occupied, uint64_t enemy_attacks, int side) {
+	int enemy = 1 - side;
 	size_t count = 0;
-	int to_square = add_offset(from_square, file_offset, rank_offset);
 
-	if (to_square != NO_SQUARE) {
-		int piece = pos->board[to_square];
+	targets &= king_attacks[king_square] & ~enemy_attacks;
 
-		if (piece == NO_PIECE || COLOR(piece) != pos->side_to_move) {
-			moves[count++] = make_move(from_square, to_square, NO_TYPE);
+	while (targets) {
+		int to_square = bb_pop_lsb(&targets);
+
+		if (!is_square_attacked(pos, to_square, enemy, occupied ^ SQUARE_BB(king_square))) {
+			moves[count++] = make_move(king_square, to_square, NO_TYPE);
 		}
 	}
 
 	return count;
 }
 
-/* generate a sliding move. this function keeps adding the offset in a loop  */
-/* until the destination square runs off the board or into another piece.    */
-/* returns the number of moves generated.                                    */
-static size_t generate_sliding_move(const struct position *pos, struct move *moves, int from_square, int file_offset, int rank_offset) {
+/* generate the moves of all pieces other than the king of the given kind,   */
+/* that end on a square in `check_mask`. pieces in `pinned` may only move    */
+/* along the line through the king. for quiet checks every piece type gets   */
+/* its own target squares from `check_info`: the squares it would attack the */
+/* enemy king from, and for pieces that block one of our sliders, every      */
+/* square off the line. returns the number of moves generated.               */
+static ALWAYS_INLINE size_t generate_piece_moves(const struct position *pos, struct move *moves, int kind, uint64_t check_mask, uint64_t pinned, const struct check_info *check_info, int king_square, uint64_t occupied, int side) {
+	int enemy = 1 - side;
+	int up = FORWARD(side);
+	uint64_t empty = ~occupied;
+	uint64_t last_rank = RANK_BB(RELATIVE(RANK_8, side));
+	uint64_t pawns = pos->bbs[side][PAWN];
+	uint64_t captures = kind & GEN_CAPTURES ? color_bb(pos, enemy) & check_mask : 0;
+	uint64_t quiets[6] = { 0, 0, 0, 0, 0, 0 };
+	uint64_t discovered = 0;
+	uint64_t pushes = 0;
+	uint64_t double_pushes = 0;
+	int enemy_king = 0;
+	uint64_t single;
+	uint64_t pieces;
 	size_t count = 0;
-	int to_square = add_offset(from_square, file_offset, rank_offset);
+	int type;
 
-	while (to_square != NO_SQUARE) {
-		int piece = pos->board[to_square];
+	/* promotions count as captures, even when the pawn doesn't capture.     */
+	if (kind & GEN_CAPTURES) {
+		pushes |= last_rank;
+	}
 
-		if (piece == NO_PIECE || COLOR(piece) != pos->side_to_move) {
-			moves[count++] = make_move(from_square, to_square, NO_TYPE);
+	if (kind & GEN_QUIETS) {
+		for (type = PAWN; type <= KING; type++) {
+			quiets[type] = empty;
+		}
+
+		pushes |= ~last_rank;
+		double_pushes = ~0ULL;
+	} else if (kind & GEN_QUIET_CHECKS) {
+		uint64_t disc_pawns;
+
+		enemy_king = check_info->king_square;
+		discovered = check_info->discovered;
+
+		for (type = PAWN; type <= QUEEN; type++) {
+			quiets[type] = check_info->check_squares[type] & empty;
+		}
+
+		/* a pawn push only leaves the line if the line isn't the file.     */
+		disc_pawns = discovered & pawns & ~(FILE_A_BB << FILE(enemy_king));
+		pushes |= ~last_rank & (quiets[PAWN] | bb_shift(disc_pawns, up));
+		double_pushes = quiets[PAWN] | bb_shift(disc_pawns, 2 * up);
+	}
+
+	pushes &= check_mask;
+	double_pushes &= check_mask;
+
+	/* pawn pushes, double pawn pushes and captures towards the a and h      */
+	/* file. pinned pawns are filtered one by one, en passant is checked     */
+	/* separately.                                                           */
+	single = bb_shift(pawns, up) & empty;
+	count += add_pawn_moves(moves + count, single & pushes, up, pinned, king_square, side);
+	count += add_pawn_moves(moves + count, bb_shift(single & RANK_BB(RELATIVE(RANK_3, side)), up) & empty & double_pushes, 2 * up, pinned, king_square, side);
+	count += add_pawn_moves(moves + count, bb_shift(pawns & ~FILE_A_BB, up - 1) & captures, up - 1, pinned, king_square, side);
+	count += add_pawn_moves(moves + count, bb_shift(pawns & ~FILE_H_BB, up + 1) & captures, up + 1, pinned, king_square, side);
+
+	if ((kind & GEN_CAPTURES) && pos->en_passant_square != NO_SQUARE) {
+		pieces = pawn_attacks[enemy][pos->en_passant_square] & pawns;
+
+		while (pieces) {
+			count += generate_en_passant(pos, moves + count, bb_pop_lsb(&pieces), king_square, occupied, side);
+		}
+	}
+
+	/* knight moves. a pinned knight can never move.                         */
+	pieces = pos->bbs[side][KNIGHT] & ~pinned;
+
+	while (pieces) {
+		int square = bb_pop_lsb(&pieces);
+		uint64_t targets = captures | quiets[KNIGHT];
+
+		if (discovered & SQUARE_BB(square)) {
+			targets |= empty;
+		}
+
+		count += add_moves(moves + count, square, knight_attacks[square] & targets & check_mask);
+	}
+
+	/* bishop, rook and queen moves.                                         */
+	pieces = pos->bbs[side][BISHOP] | pos->bbs[side][ROOK] | pos->bbs[side][QUEEN];
+
+	while (pieces) {
+		int square = bb_pop_lsb(&pieces);
+		uint64_t targets;
+		uint64_t attacks = 0;
+
+		type = TYPE(pos->board[square]);
+		targets = captures | quiets[type];
+
+		if (discovered & SQUARE_BB(square)) {
+			targets |= empty & ~line_bb[enemy_king][square];
 		}
 
-		if (piece != NO_PIECE) {
-			break;
+		if (type != ROOK) {
+			attacks |= bishop_attacks(square, occupied);
 		}
 
-		to_square = add_offset(to_square, file_offset, rank_offset);
+		if (type != BISHOP) {
+			attacks |= rook_attacks(square, occupied);
+		}
+
+		if (pinned & SQUARE_BB(square)) {
+			attacks &= line_bb[king_square][square];
+		}
+
+		count += add_moves(moves + count, square, attacks & targets & check_mask);
 	}
 
 	return count;
 }
 
-size_t generate_pseudo_legal_moves(const struct position *pos, struct move *moves) {
-#if false
-	// TODOOOOO: Use bitboards
-#else
+/* generate castling moves. this must only be called when not in check. the  */
+/* king may not pass through or land on an attacked square. returns the      */
+/* number of moves generated.                                                */
+static ALWAYS_INLINE size_t generate_castling(const struct position *pos, struct move *moves, int king_square, uint64_t occupied, int side) {
+	int enemy = 1 - side;
+	int rank = RELATIVE(RANK_1, side);
 	size_t count = 0;
-	int forward = pos->side_to_move == WHITE ? 1 : -1;
-	int square;
 
-	for (square = 0; square < 64; square++) {
-		int piece = pos->board[square];
+	if (pos->castling_rights[side] & KING_SIDE) {
+		int f1 = SQUARE(FILE_F, rank);
+		int g1 = SQUARE(FILE_G, rank);
 
-		/* skip this square if it is empty or contains an opponent piece.    */
-		if (piece == NO_PIECE || COLOR(piece) != pos->side_to_move) {
-			continue;
+		if (!(occupied & (SQUARE_BB(f1) | SQUARE_BB(g1)))
+				&& !is_square_attacked(pos, f1, enemy, occupied)
+				&& !is_square_attacked(pos, g1, enemy, occupied)) {
+			moves[count++] = make_special_move(king_square, g1, MOVE_CASTLING);
 		}
+	}
 
-		switch (TYPE(piece)) {
-			int up;
-			int up_up;
-
-		case PAWN:
-			up = add_offset(square, 0, forward);
-			up_up = add_offset(square, 0, forward * 2);
-
-			/* pawn push.                                                    */
-			if (up != NO_SQUARE && pos->board[up] == NO_PIECE) {
-				count += generate_pawn_move(pos, moves + count, square, up);
-
-				/* double pawn push.                                         */
-				if (up_up != NO_SQUARE && pos->board[up_up] == NO_PIECE) {
-					if (RANK(square) == RELATIVE(RANK_2, COLOR(piece))) {
-						count += generate_pawn_move(pos, moves + count, square, up_up);
-					}
-				}
-			}
+	if (pos->castling_rights[side] & QUEEN_SIDE) {
+		int b1 = SQUARE(FILE_B, rank);
+		int c1 = SQUARE(FILE_C, rank);
+		int d1 = SQUARE(FILE_D, rank);
 
-			/* pawn captures.                                                */
-			count += generate_pawn_capture(pos, moves + count, square, -1, forward);
-			count += generate_pawn_capture(pos, moves + count, square, 1, forward);
-
-			break;
-		case KNIGHT:
-			/* knight moves.                                                 */
-			count += generate_simple_move(pos, moves + count, square, -1, -2);
-			count += generate_simple_move(pos, moves + count, square, 1, -2);
-			count += generate_simple_move(pos, moves + count, square, -2, -1);
-			count += generate_simple_move(pos, moves + count, square, 2, -1);
-			count += generate_simple_move(pos, moves + count, square, -2, 1);
-			count += generate_simple_move(pos, moves + count, square, 2, 1);
-			count += generate_simple_move(pos, moves + count, square, -1, 2);
-			count += generate_simple_move(pos, moves + count, square, 1, 2);
-
-			break;
-		case BISHOP:
-		case ROOK:
-		case QUEEN:
-			/* bishop and queen moves.                                       */
-			if (TYPE(piece) != ROOK) {
-				count += generate_sliding_move(pos, moves + count, square, -1, -1);
-				count += generate_sliding_move(pos, moves + count, square, 1, -1);
-				count += generate_sliding_move(pos, moves + count, square, -1, 1);
-				count += generate_sliding_move(pos, moves + count, square, 1, 1);
-			}
+		if (!(occupied & (SQUARE_BB(b1) | SQUARE_BB(c1) | SQUARE_BB(d1)))
+				&& !is_square_attacked(pos, c1, enemy, occupied)
+				&& !is_square_attacked(pos, d1, enemy, occupied)) {
+			moves[count++] = make_special_move(king_square, c1, MOVE_CASTLING);
+		}
+	}
 
-			/* rook and queen moves.                                         */
-			if (TYPE(piece) != BISHOP) {
-				count += generate_sliding_move(pos, moves + count, square, 0, -1);
-				count += generate_sliding_move(pos, moves + count, square, -1, 0);
-				count += generate_sliding_move(pos, moves + count, square, 1, 0);
-				count += generate_sliding_move(pos, moves + count, square, 0, 1);
-			}
+	return count;
+}
 
-			break;
-		case KING:
-			/* simple king moves.                                            */
-			count += generate_simple_move(pos, moves + count, square, -1, -1);
-			count += generate_simple_move(pos, moves + count, square, 0, -1);
-			count += generate_simple_move(pos, moves + count, square, 1, -1);
-			count += generate_simple_move(pos, moves + count, square, -1, 0);
-			count += generate_simple_move(pos, moves + count, square, 1, 0);
-			count += generate_simple_move(pos, moves + count, square, -1, 1);
-			count += generate_simple_move(pos, moves + count, square, 0, 1);
-			count += generate_simple_move(pos, moves + count, square, 1, 1);
-
-			/* king side castling.                                           */
-			if (pos->castling_rights[pos->side_to_move] & KING_SIDE) {
-				int f1 = SQUARE(FILE_F, RELATIVE(RANK_1, pos->side_to_move));
-				int g1 = SQUARE(FILE_G, RELATIVE(RANK_1, pos->side_to_move));
-				int f1_empty = pos->board[f1] == NO_PIECE;
-				int g1_empty = pos->board[g1] == NO_PIECE;
-
-				if (f1_empty && g1_empty) {
-					moves[count++] = make_move(square, g1, NO_TYPE);
-				}
-			}
+uint64_t get_checkers(const struct position *pos) {
+	int side = pos->side_to_move;
+	uint64_t occupied = pos->occupied;
 
-			/* queen side castling.                                          */
-			if (pos->castling_rights[pos->side_to_move] & QUEEN_SIDE) {
-				int b1 = SQUARE(FILE_B, RELATIVE(RANK_1, pos->side_to_move));
-				int c1 = SQUARE(FILE_C, RELATIVE(RANK_1, pos->side_to_move));
-				int d1 = SQUARE(FILE_D, RELATIVE(RANK_1, pos->side_to_move));
-				int b1_empty = pos->board[b1] == NO_PIECE;
-				int c1_empty = pos->board[c1] == NO_PIECE;
-				int d1_empty = pos->board[d1] == NO_PIECE;
-
-				if (b1_empty && c1_empty && d1_empty) {
-					moves[count++] = make_move(square, c1, NO_TYPE);
-				}
-			}
+	return attackers_to(pos, bb_lsb(pos->bbs[side][KING]), occupied) & color_bb(pos, 1 - side);
+}
 
-			break;
-		}
+/* returns the squares the king may move to for the given kind of moves,    */
+/* before checking whether they are attacked. the king can only give a       */
+/* discovered check, by stepping off the line between our slider and the     */
+/* enemy king.                                                               */
+static ALWAYS_INLINE uint64_t get_king_targets(const struct position *pos, int kind, const struct check_info *check_info, int king_square, uint64_t occupied, int side) {
+	uint64_t targets = kind & GEN_CAPTURES ? color_bb(pos, 1 - side) : 0;
+
+	if (kind & GEN_QUIETS) {
+		targets |= ~occupied;
+	} else if ((kind & GEN_QUIET_CHECKS) && (check_info->discovered & SQUARE_BB(king_square))) {
+		targets |= ~occupied & ~line_bb[check_info->king_square][king_square];
+	}
+
+	return targets;
+}
+
+/* generate the legal moves of the given kind when in check. returns the     */
+/* number of moves generated.                                                */
+static size_t generate_evasions(const struct position *pos, struct move *moves, int kind, uint64_t checkers, uint64_t pinned, const struct check_info *check_info, uint64_t enemy_attacks, int side) {
+	int king_square = bb_lsb(pos->bbs[side][KING]);
+	uint64_t occupied = pos->occupied;
+	uint64_t targets = get_king_targets(pos, kind, check_info, king_square, occupied, side);
+	size_t count = generate_king_moves(pos, moves, targets, king_square, occupied, enemy_attacks, side);
+
+	/* in double check only the king can move.                               */
+	if (checkers & (checkers - 1)) {
+		return count;
+	}
+
+	/* otherwise the checker must be captured, or the check blocked. the pin */
+	/* line and the check line only meet on the king, so the pin mask keeps  */
+	/* pinned pieces from doing either. castling is never legal in check.    */
+	count += generate_piece_moves(pos, moves + count, kind, between_bb[king_square][bb_lsb(checkers)] | checkers, pinned, check_info, king_square, occupied, side);
+
+	return count;
+}
+
+/* `generate_moves` for one color, see `COLOR_DISPATCH`. the checkers and    */
+/* the pinned pieces either come from the attack map or are computed by the  */
+/* caller. `check_info` is only read for quiet checks.                       */
+static ALWAYS_INLINE size_t generate_moves_for(const struct position *pos, struct move *moves, int kind, uint64_t checkers, uint64_t pinned, const struct check_info *check_info, uint64_t enemy_attacks, int side) {
+	int king_square = bb_lsb(pos->bbs[side][KING]);
+	uint64_t occupied = pos->occupied;
+	uint64_t targets;
+	size_t count;
+
+	if (checkers) {
+		return generate_evasions(pos, moves, kind, checkers, pinned, check_info, enemy_attacks, side);
+	}
+
+	targets = get_king_targets(pos, kind, check_info, king_square, occupied, side);
+	count = generate_king_moves(pos, moves, targets, king_square, occupied, enemy_attacks, side);
+	count += generate_piece_moves(pos, moves + count, kind, ~0ULL, pinned, check_info, king_square, occupied, side);
+
+	if (kind & GEN_QUIETS) {
+		count += generate_castling(pos, moves + count, king_square, occupied, side);
 	}
 
 	return count;
-#endif
+}
+
+size_t generate_moves(const struct position *pos, struct move *moves, int kind, const struct attack_map *attacks) {
+	int side = pos->side_to_move;
+
+	return COLOR_DISPATCH(side, generate_moves_for, pos, moves, kind, attacks->checkers, attacks->pinned[side], &attacks->check_info, attacks->by_color[1 - side]);
 }
 
 size_t generate_legal_moves(const struct position *pos, struct move *moves) {
-	size_t pseudo_legal_count = generate_pseudo_legal_moves(pos, moves);
-	size_t index;
-	size_t count = 0;
+	int side = pos->side_to_move;
+	uint64_t pinned = pinned_pieces(pos, side, bb_lsb(pos->bbs[side][KING]), pos->occupied);
+
+	/* a whole attack map is more than perft needs, so only the checkers and */
+	/* the pins are computed here.                                           */
+	return COLOR_DISPATCH(side, generate_moves_for, pos, moves, GEN_ALL, get_checkers(pos), pinned, NULL, 0);
+}
+
+void init_attack_map(const struct position *pos, struct attack_map *attacks) {
+	uint64_t occupied = pos->occupied;
+	int color;
+
+	for (color = WHITE; color <= BLACK; color++) {
+		int king_square = bb_lsb(pos->bbs[color][KING]);
+		uint64_t pawns = pos->bbs[color][PAWN];
+		uint64_t queen_orthogonal;
+		uint64_t queen_diagonal;
+		uint64_t pieces;
+		int type;
+
+		attacks->by_type[color][PAWN] = bb_shift(pawns & ~FILE_A_BB, FORWARD(color) - 1) | bb_shift(pawns & ~FILE_H_BB, FORWARD(color) + 1);
+		attacks->by_type[color][KNIGHT] = 0;
+		attacks->by_type[color][KING] = king_attacks[king_square];
+
+		pieces = pos->bbs[color][KNIGHT];
+
+		while (pieces) {
+			attacks->by_type[color][KNIGHT] |= knight_attacks[bb_pop_lsb(&pieces)];
+		}
 
-	for (index = 0; index < pseudo_legal_count; index++) {
-		if (is_legal(pos, moves[index])) {
-			moves[count++] = moves[index];
+		/* the sliders are filled all at once instead of looked up one by    */
+		/* one. rooks and bishops share a fill, the queens get their own.    */
+		slider_fill(pos->bbs[color][ROOK], pos->bbs[color][BISHOP], occupied,
+			&attacks->by_type[color][ROOK], &attacks->by_type[color][BISHOP]);
+		slider_fill(pos->bbs[color][QUEEN], pos->bbs[color][QUEEN], occupied,
+			&queen_orthogonal, &queen_diagonal);
+		attacks->by_type[color][QUEEN] = queen_orthogonal | queen_diagonal;
+
+		attacks->by_color[color] = 0;
+
+		for (type = PAWN; type <= KING; type++) {
+			attacks->by_color[color] |= attacks->by_type[color][type];
 		}
+
+		attacks->pinned[color] = pinned_pieces(pos, color, king_square, occupied);
 	}
 
-	return count;
+	attacks->checkers = get_checkers(pos);
+	init_check_info(pos, &attacks->check_info);
+}
+
+int is_pseudo_legal(const struct position *pos, struct move move) {
+	int side = pos->side_to_move;
+	int piece = pos->board[move.from_square];
+	uint64_t own = color_bb(pos, side);
+	uint64_t enemy = color_bb(pos, 1 - side);
+	uint64_t occupied = pos->occupied;
+	uint64_t to = SQUARE_BB(move.to_square);
+	int forward = side == WHITE ? 8 : -8;
+	int is_last_rank = RANK(move.to_square) == RELATIVE(RANK_8, side);
+
+	/* the piece must be ours, and it may not capture our own pieces.        */
+	if (piece == NO_PIECE || COLOR(piece) != side || (own & to)) {
+		return 0;
+	}
+
+	if (move.special == MOVE_CASTLING) {
+		struct move moves[2];
+		size_t count = TYPE(piece) == KING ? generate_castling(pos, moves, move.from_square, occupied, side) : 0;
+		size_t index;
+
+		for (index = 0; index < count; index++) {
+			if (moves[index].to_square == move.to_square) {
+				return 1;
+			}
+		}
+
+		return 0;
+	}
+
+	if (TYPE(piece) != PAWN) {
+		uint64_t attacks;
+
+		if (move.special != MOVE_NORMAL) {
+			return 0;
+		}
+
+		switch (TYPE(piece)) {
+		case KNIGHT: attacks = knight_attacks[move.from_square]; break;
+		case BISHOP: attacks = bishop_attacks(move.from_square, occupied); break;
+		case ROOK: attacks = rook_attacks(move.from_square, occupied); break;
+		case QUEEN: attacks = queen_attacks(move.from_square, occupied); break;
+		default: attacks = king_attacks[move.from_square]; break;
+		}
+
+		return (attacks & to) != 0;
+	}
+
+	/* pawn moves. promotions must be marked as such, and nothing else.      */
+	if (move.special == MOVE_EN_PASSANT) {
+		return move.to_square == pos->en_passant_square && (pawn_attacks[side][move.from_square] & to);
+	}
+
+	if (is_last_rank != (move.special == MOVE_PROMOTION)) {
+		return 0;
+	}
+
+	if (pawn_attacks[side][move.from_square] & to) {
+		return (enemy & to) != 0;
+	}
+
+	if (move.to_square == move.from_square + forward) {
+		return !(occupied & to);
+	}
+
+	if (move.to_square == move.from_square + 2 * forward && RANK(move.from_square) == RELATIVE(RANK_2, side)) {
+		return !(occupied & (to | SQUARE_BB(move.from_square + forward)));
+	}
+
+	return 0;
+}
+
+int is_legal(const struct position *pos, struct move move, const struct attack_map *attacks) {
+	int side = pos->side_to_move;
+	int king_square = bb_lsb(pos->bbs[side][KING]);
+	uint64_t occupied = pos->occupied;
+	uint64_t checkers = attacks->checkers;
+
+	/* castling is checked completely by `is_pseudo_legal`, apart from       */
+	/* castling out of check.                                                */
+	if (move.special == MOVE_CASTLING) {
+		return !checkers;
+	}
+
+	if (move.special == MOVE_EN_PASSANT) {
+		struct move moves[1];
+
+		return generate_en_passant(pos, moves, move.from_square, king_square, occupied, side) == 1;
+	}
+
+	if (move.from_square == king_square) {
+		return !(attacks->by_color[1 - side] & SQUARE_BB(move.to_square))
+			&& !is_square_attacked(pos, move.to_square, 1 - side, occupied ^ SQUARE_BB(king_square));
+	}
+
+	/* in check, the move must capture the checker or block the check.       */
+	if (checkers) {
+		if (checkers & (checkers - 1)) {
+			return 0;
+		}
+
+		if (!((between_bb[king_square][bb_lsb(checkers)] | checkers) & SQUARE_BB(move.to_square))) {
+			return 0;
+		}
+	}
+
+	/* a pinned piece may only move along the pin.                           */
+	if (attacks->pinned[side] & SQUARE_BB(move.from_square)) {
+		return (line_bb[king_square][move.from_square] & SQUARE_BB(move.to_square)) != 0;
+	}
+
+	return 1;
 }
@@ -1,11 +1,14 @@
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
+#include <strings.h>
 #include <stdbool.h>
 #include <sys/poll.h>
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <unistd.h>
 #include <execinfo.h>
 #include <signal.h>
@@ -17,8 +20,15 @@
 #include "generate.h"
 #include "basedboard.h"
 #include "uci.h"
-#include "pst.h"
+#include "zobrist.h"
+#include "psq.h"
+#include "tt.h"
+#include "pawns.h"
+#include "material.h"
+#include "eval_cache.h"
 #include "state.h"
+#include "attack.h"
+#include "perft.h"
 
 /// CONFIGURATION
 
@@ -142,6 +152,9 @@ typedef long long t_score;
 
 struct position g_pos, g_real_pos;
 
+// The positions before g_pos, both the game so far and the current search path
+struct history g_history, g_real_history;
+
 char *g_commands[1024];
 size_t g_commands_head = 0;
 size_t g_commands_tail = 0;
@@ -226,52 +239,11 @@ t_score get_piece_value(int type) {
 	}
 }
 
-bool is_end_game(void) {
-	int minor_count = bb_count(g_pos.bbs[WHITE][KNIGHT]) + bb_count(g_pos.bbs[WHITE][BISHOP]) + bb_count(g_pos.bbs[WHITE][ROOK])
-		+ bb_count(g_pos.bbs[BLACK][KNIGHT]) + bb_count(g_pos.bbs[BLACK][BISHOP]) + bb_count(g_pos.bbs[BLACK][ROOK]);
-
-	// if queens are off the board, and less than 9 minor pieces
-	if (bb_count(g_pos.bbs[WHITE][QUEEN]) == 0 && bb_count(g_pos.bbs[BLACK][QUEEN]) == 0) {
-		if (minor_count < 9) {
-			return true;
-		}
-	}
-
-	// if queens and less than 5 minor pieces
-	if (bb_count(g_pos.bbs[WHITE][QUEEN]) == 1 && bb_count(g_pos.bbs[BLACK][QUEEN]) == 1) {
-		if (minor_count < 5) {
-			return true;
-		}
-	}
-
-	// if one queen off the board and less than 7 minor pieces
-	if (bb_count(g_pos.bbs[WHITE][QUEEN]) + bb_count(g_pos.bbs[BLACK][QUEEN]) == 1) {
-		if (minor_count < 7) {
-			return true;
-		}
-	}
-
-	return false;
-}
-
-t_score get_square_value(int piece, int square) {
+// Material plus piece square table value of the piece on the square, from the piece's own point of view
+t_score get_square_value(int piece, int square, bool end_game) {
 	ASSERT(piece != NO_PIECE);
 
-	switch (TYPE(piece)) {
-		case PAWN:
-			return (is_end_game() ? pawn_squares_end : pawn_squares_mid)[COLOR(piece) == WHITE ? 63 - square : square];
-		case KNIGHT:
-			return (is_end_game() ? knight_squares_end : knight_squares_mid)[COLOR(piece) == WHITE ? 63 - square : square];
-		case BISHOP:
-			return (is_end_game() ? bishop_squares_end : bishop_squares_mid)[COLOR(piece) == WHITE ? 63 - square : square];
-		case ROOK:
-			return (is_end_game() ? rook_squares_end : rook_squares_mid)[COLOR(piece) == WHITE ? 63 - square : square];
-		case QUEEN:
-			return (is_end_game() ? queen_squares_end : queen_squares_mid)[COLOR(piece) == WHITE ? 63 - square : square];
-		case KING:
-			return (is_end_game() ? king_squares_end : king_squares_mid)[COLOR(piece) == WHITE ? 63 - square : square];
-		default: UNREACHABLE();
-	}
+	return g_psq[piece][square][end_game ? PSQ_EG : PSQ_MG] * (COLOR(piece) == WHITE ? 1 : -1);
 }
 
 int get_square_color(int square) {
@@ -294,131 +266,178 @@ int pawn_color(int color) {
 	}
 }
 
-struct move g_null_moves[MAX_MOVES];
+/// MOVE STACK
 
-t_score evaluate(void) {
-	t_score score = 0;
+#define MAX_PLY 64
 
-	// Material count
-	int p_colors[2] = {pawn_color(WHITE), pawn_color(BLACK)};
-	for (int c = WHITE; c <= BLACK; c++) {
-		score += bb_count(g_pos.bbs[c][PAWN] & color_mask(p_colors[c])) * get_piece_value(PAWN) * 1.1 * (c == WHITE ? 1 : -1);  // Note: we want all the pawns on the same color
-		score += bb_count(g_pos.bbs[c][PAWN] & color_mask(!p_colors[c])) * get_piece_value(PAWN) * 0.9 * (c == WHITE ? 1 : -1);
-		score += bb_count(g_pos.bbs[c][KNIGHT] & color_mask(p_colors[c])) * get_piece_value(KNIGHT) * 1.1 * (c == WHITE ? 1 : -1);  // Note: we want the knight on the same color as the pawns
-		score += bb_count(g_pos.bbs[c][KNIGHT] & color_mask(!p_colors[c])) * get_piece_value(KNIGHT) * 0.9 * (c == WHITE ? 1 : -1);
-		score += bb_count(g_pos.bbs[c][BISHOP] & color_mask(!p_colors[c])) * get_piece_value(BISHOP) * 1.1 * (c == WHITE ? 1 : -1);  // Note: we want the bishop on the opposite color of the pawns
-		score += bb_count(g_pos.bbs[c][BISHOP] & color_mask(p_colors[c])) * get_piece_value(BISHOP) * 0.9 * (c == WHITE ? 1 : -1);
-		score += bb_count(g_pos.bbs[c][QUEEN]) * get_piece_value(QUEEN) * (c == WHITE ? 1 : -1);  // Note: we don't really care about the queen's position
-		score += bb_count(g_pos.bbs[c][ROOK]) * get_piece_value(ROOK) * (c == WHITE ? 1 : -1);  // Note: we don't really care about the rook's position
-		score += bb_count(g_pos.bbs[c][KING]) * get_piece_value(KING) * (c == WHITE ? 1 : -1);  // Note: we don't really care about the king's position
-	}
-
-	// Piece square tables
-	for (int i = 0; i < 64; i++) {
-		if (g_pos.board[i] == NO_PIECE) {
-			continue;
-		}
+// Worst case every ply has MAX_MOVES moves. Quiescence plies come on top of the MAX_PLY search plies.
+#define MOVE_STACK_SIZE (MAX_MOVES * MAX_PLY * 2)
 
-		int color = COLOR(g_pos.board[i]);
-		score += get_square_value(g_pos.board[i], i) * (color == WHITE ? 1 : -1);
-	}
+// The moves of every node on the current search path, each ply right after its parent's.
+// Like g_pos, it belongs to the search, so keeps the hot move lists in one dense block instead of a MAX_MOVES array per stack frame.
+typedef struct {
+	struct move moves[MOVE_STACK_SIZE];
+	int scores[MOVE_STACK_SIZE];
+	size_t top;
+} t_move_stack;
 
-	// Pawn structure
-	// TODO: Test and tweak
-	for (int c = WHITE; c <= BLACK; c++) {
-		for (int i = 0; i < 7; i++) {
-			// Get pawn on file i
-			uint64_t pawn = g_pos.bbs[c][PAWN] & FILE_MASK(i);
-			uint64_t neighbor = pawn >> 1;
-			uint64_t neighbor_up = neighbor << 8;
-			uint64_t neighbor_down = neighbor >> 8;
+t_move_stack g_move_stack;
 
-			// Check if pawn is defended by pawn or if is defending a pawn
-			if ((g_pos.bbs[c][PAWN] & neighbor_up) != 0 || (g_pos.bbs[c][PAWN] & neighbor_down) != 0) {
-				score += 10 * (c == WHITE ? 1 : -1);
-			} else {
-				score -= 10 * (c == WHITE ? 1 : -1);
-			}
-		}
+// Returns room for MAX_MOVES moves above the top. It stays free until the caller moves the top past it.
+struct move *move_stack_peek(void) {
+	ASSERT(g_move_stack.top + MAX_MOVES <= MOVE_STACK_SIZE);
+
+	return g_move_stack.moves + g_move_stack.top;
+}
+
+
+// Per square of mobility, and the number of squares a piece of the type has in a typical position. Pieces with more room
+// than usual gain, cramped ones lose, and a piece is worth its material no matter how many squares it has.
+// https://www.chessprogramming.org/Mobility
+static const int g_mobility_weight[6] = {0, 4, 5, 2, 1, 0};
+static const int g_mobility_center[6] = {0, 4, 6, 7, 13, 0};
+
+// The most squares a piece of the type can ever attack
+static const int g_mobility_max[6] = {0, 8, 13, 14, 27, 0};
+
+static ALWAYS_INLINE uint64_t piece_attacks(int type, int square, uint64_t occupied) {
+	switch (type) {
+		case KNIGHT: return knight_attacks[square];
+		case BISHOP: return bishop_attacks(square, occupied);
+		case ROOK: return rook_attacks(square, occupied);
+		case QUEEN: return queen_attacks(square, occupied);
+		default: UNREACHABLE();
 	}
+}
 
-	// Doubled pawns
-	for (int c = WHITE; c <= BLACK; c++) {
-		for (int i = 0; i < 7; i++) {
-			// Get pawns on file i
-			uint64_t pawns = g_pos.bbs[c][PAWN] & FILE_MASK(i);
+// The mobility of the pieces of color c, from white's point of view. c is a constant, see COLOR_DISPATCH.
+// Squares of our own pieces and squares attacked by their pawns don't count, a piece can't safely go there.
+static ALWAYS_INLINE t_score evaluate_mobility(const struct attack_map *attacks, int c) {
+	uint64_t available = ~g_pos.colors[c] & ~attacks->by_type[1 - c][PAWN];
+	t_score score = 0;
 
-			// Check if its doubled
-			if (bb_count(pawns) > 1) {
-				score -= 5 * bb_count(pawns) * (c == WHITE ? 1 : -1);
-			}
+	for (int type = KNIGHT; type <= QUEEN; type++) {
+		uint64_t pieces = g_pos.bbs[c][type];
+
+		while (pieces) {
+			uint64_t reach = piece_attacks(type, bb_pop_lsb(&pieces), g_pos.occupied) & available;
+
+			score += (bb_count(reach) - g_mobility_center[type]) * g_mobility_weight[type];
 		}
 	}
 
-	// Pins
-	// TODO
-	// piece of value x is blocking a piece of value >= x, and is attacked by a piece of value < x
+	return c == WHITE ? score : -score;
+}
 
-	// Mobility (100 moves is worth a pawn)
-	// // BLUNDER: Sacks bishop
-	// // r3kbnr/pp2pppp/2p1b3/8/8/3B4/PPPP1PPP/RNB2RK1 w kq - 1 9
-	score += generate_legal_moves(&g_pos, g_null_moves) * (g_pos.side_to_move == WHITE ? 1 : -1);
+// Pawns and knights are worth 10% more on the color of the squares most of our pawns are on, and 10% less on the other
+// color. Bishops the other way around, they want the squares our pawns don't block. From white's point of view, c is a
+// constant, see COLOR_DISPATCH.
+static ALWAYS_INLINE t_score evaluate_square_colors(int c) {
+	uint64_t pawn_squares = color_mask(pawn_color(c));
+	t_score score = 0;
+
+	score += (bb_count(g_pos.bbs[c][PAWN] & pawn_squares) - bb_count(g_pos.bbs[c][PAWN] & ~pawn_squares)) * get_piece_value(PAWN) / 10;
+	score += (bb_count(g_pos.bbs[c][KNIGHT] & pawn_squares) - bb_count(g_pos.bbs[c][KNIGHT] & ~pawn_squares)) * get_piece_value(KNIGHT) / 10;
+	score += (bb_count(g_pos.bbs[c][BISHOP] & ~pawn_squares) - bb_count(g_pos.bbs[c][BISHOP] & pawn_squares)) * get_piece_value(BISHOP) / 10;
 
-	return score * (g_pos.side_to_move == WHITE ? 1 : -1);
+	return c == WHITE ? score : -score;
 }
 
-bool is_in_check(struct position *pos) {
-	pos->side_to_move = 1 - pos->side_to_move;
+// How far the expensive terms can move the evaluation at most. Mobility is the only one, and each piece moves it by at
+// most its weight times how far its square count can get from the center. Scaling only shrinks that, apart from one
+// point of rounding. When the cheap terms are further than this outside the window, the real score is outside it too.
+// https://www.chessprogramming.org/Lazy_Evaluation
+static ALWAYS_INLINE t_score lazy_margin(void) {
+	t_score margin = 1;
 
-	struct move moves[MAX_MOVES];
-	size_t moves_count = generate_pseudo_legal_moves(pos, moves);
-	for (size_t i = 0; i < moves_count; i++) {
-		if (pos->board[moves[i].to_square] == NO_PIECE) {
-			continue;
-		}
+	for (int type = KNIGHT; type <= QUEEN; type++) {
+		int most = g_mobility_max[type] - g_mobility_center[type];
+		int fewest = g_mobility_center[type];
 
-		if (TYPE(pos->board[moves[i].to_square]) == KING) {
-			pos->side_to_move = 1 - pos->side_to_move;
-			return true;
-		}
+		margin += bb_count(g_pos.bbs[WHITE][type] | g_pos.bbs[BLACK][type]) * (most > fewest ? most : fewest) * g_mobility_weight[type];
 	}
 
-	pos->side_to_move = 1 - pos->side_to_move;
-	return false;
+	return margin;
 }
 
-bool is_capture(struct position *pos, struct move move) {
-	return pos->board[move.to_square] != NO_PIECE;
-}
+// Evaluations that stopped after the cheap terms, since the start of the search
+uint64_t g_lazy_exits;
+
+// The evaluation from the point of view of us, the side to move. us is a constant, see COLOR_DISPATCH.
+// Sets lazy and returns a bound instead of the score if the score is outside the window for sure: at least the bound
+// if it is at least beta, at most the bound if it is at most alpha.
+static ALWAYS_INLINE t_score evaluate_for(const struct attack_map *attacks, t_score alpha, t_score beta, bool *lazy, int us) {
+	const int sign = us == WHITE ? 1 : -1;
+	const t_material_entry *material = material_probe(&g_pos);
+
+	// Cheap terms, kept up to date by do_move, looked up by material key or counted in a few popcounts.
+	// Material and piece square tables, blended from the middle game to the end game by game phase.
+	t_score score = ((t_score) g_pos.psq[PSQ_MG] * material->phase + (t_score) g_pos.psq[PSQ_EG] * (PHASE_MAX - material->phase)) / PHASE_MAX;
+
+	score += material->imbalance;
+
+	score += evaluate_square_colors(WHITE) + evaluate_square_colors(BLACK);
+
+	// Pawn structure, usually straight from the pawn hash table. Passed pawns alone can be worth more than any fixed
+	// margin, so it isn't left out.
+	score += evaluate_pawns(&g_pos);
+
+	// Scaling only pulls scores towards 0, so it doesn't take the bounds past the real score
+	t_score cheap = score * material->scale[score > 0 ? WHITE : BLACK] / SCALE_NORMAL * sign;
+	t_score margin = lazy_margin();
+	if (cheap - margin >= beta || cheap + margin <= alpha) {
+		*lazy = true;
+		return cheap - margin >= beta ? cheap - margin : cheap + margin;
+	}
+
+	// Expensive terms
+	// Pins
+	// TODO
+	// piece of value x is blocking a piece of value >= x, and is attacked by a piece of value < x
+
+	// Mobility of both sides
+	score += evaluate_mobility(attacks, WHITE) + evaluate_mobility(attacks, BLACK);
 
-bool is_check(struct position *pos, struct move move) {
-	struct position copy = *pos;
-	do_move(&copy, move);
+	// Pull scores of material that can't win towards a draw
+	score = score * material->scale[score > 0 ? WHITE : BLACK] / SCALE_NORMAL;
 
-	return is_in_check(&copy);
+	return score * sign;
 }
 
-bool is_quiescence_move(struct position *pos, struct move move) {
-	if (is_capture(pos, move)) {
-		return true;
+// attacks is the attack map of g_pos. Scores outside the window from alpha to beta may come back as a bound, see
+// evaluate_for. Those are not cached.
+t_score evaluate(const struct attack_map *attacks, t_score alpha, t_score beta) {
+	int32_t cached;
+
+	if (eval_cache_probe(g_pos.key, &cached)) {
+		return cached;
 	}
 
-	if (is_check(pos, move)) {
-		return true;
+	bool lazy = false;
+	t_score score = COLOR_DISPATCH(g_pos.side_to_move, evaluate_for, attacks, alpha, beta, &lazy);
+
+	if (lazy) {
+		g_lazy_exits++;
+	} else {
+		eval_cache_store(g_pos.key, score);
 	}
 
-	return false;
+	return score;
+}
+
+bool is_capture(struct position *pos, struct move move) {
+	return pos->board[move.to_square] != NO_PIECE;
 }
 
 // TODO: Improve
-long long score_move(struct position *pos, struct move move) {
-	long long score = 0;
+int score_move(struct position *pos, struct move move, const struct check_info *check_info, bool end_game) {
+	int score = 0;
 
 	if (is_capture(pos, move)) {
 		score += get_piece_value(TYPE(pos->board[move.to_square]));
 	}
 
-	if (is_check(pos, move)) {
+	if (gives_check(pos, move, check_info)) {
 		score += 3000;
 	}
 
@@ -428,29 +447,204 @@ long long score_move(struct position *pos, struct move move) {
 	// }
 
 	// new piece square value
-	int current_square_value = get_square_value(g_pos.board[move.from_square], move.from_square);
-	int new_square_value = get_square_value(g_pos.board[move.from_square], move.to_square);
+	int current_square_value = get_square_value(g_pos.board[move.from_square], move.from_square, end_game);
+	int new_square_value = get_square_value(g_pos.board[move.from_square], move.to_square, end_game);
 	score += new_square_value - current_square_value;
 
 	return score;
 }
 
-int compare_moves(struct move *a, struct move *b) {
-	return b->score - a->score;
+// Scores live in their own array next to the moves, so moves stay 16 bits
+void score_moves(struct position *pos, struct move *moves, int *scores, size_t count, const struct attack_map *attacks) {
+	bool end_game = material_probe(pos)->end_game;
+
+	for (size_t i = 0; i < count; i++) {
+		scores[i] = score_move(pos, moves[i], &attacks->check_info, end_game);
+	}
 }
 
-bool move_eq(struct move a, struct move b) {
-	return a.from_square == b.from_square && a.to_square == b.to_square && a.promotion_type == b.promotion_type;
+// Insertion sort, best score first. Move lists are short, and this keeps the two arrays in step.
+void sort_moves(struct move *moves, int *scores, size_t count) {
+	for (size_t i = 1; i < count; i++) {
+		struct move move = moves[i];
+		int score = scores[i];
+		size_t j = i;
+
+		while (j > 0 && scores[j - 1] < score) {
+			moves[j] = moves[j - 1];
+			scores[j] = scores[j - 1];
+			j--;
+		}
+
+		moves[j] = move;
+		scores[j] = score;
+	}
 }
 
-void score_moves(struct position *pos, struct move *moves, size_t count) {
-	for (size_t i = 0; i < count; i++) {
-		moves[i].score = score_move(pos, moves[i]);
+/// MOVE PICKER
+
+// Quiet moves that caused a beta cutoff, two per ply. Sibling nodes often refute the same way.
+struct move g_killers[MAX_PLY][2];
+
+// The best move of the previous iteration, tried first at the root
+struct move g_root_move;
+
+typedef enum {
+	STAGE_HASH_MOVE,
+	STAGE_GENERATE_CAPTURES,
+	STAGE_CAPTURES,
+	STAGE_KILLERS,
+	STAGE_GENERATE_QUIETS,
+	STAGE_QUIETS,
+	STAGE_DONE,
+} t_stage;
+
+// Hands out the moves of a node one at a time, generating and ordering them in stages.
+// Most nodes cut off on the hash move or a capture, so the quiet moves are never generated.
+typedef struct {
+	struct position *pos;
+	const struct attack_map *attacks;
+	t_stage stage;
+	struct move hash_move;
+	struct move killers[2];
+	size_t killer_index;
+	size_t base;  // Where this node's moves start on the move stack
+	struct move *moves;
+	int *scores;
+	size_t count;
+	size_t index;
+} t_move_picker;
+
+void init_move_picker(t_move_picker *picker, struct position *pos, const struct attack_map *attacks, struct move hash_move, int ply) {
+	picker->pos = pos;
+	picker->attacks = attacks;
+	picker->stage = STAGE_HASH_MOVE;
+	picker->hash_move = hash_move;
+	picker->killers[0] = ply < MAX_PLY ? g_killers[ply][0] : NO_MOVE;
+	picker->killers[1] = ply < MAX_PLY ? g_killers[ply][1] : NO_MOVE;
+	picker->killer_index = 0;
+	picker->base = g_move_stack.top;
+	picker->moves = move_stack_peek();
+	picker->scores = g_move_stack.scores + picker->base;
+	picker->count = 0;
+	picker->index = 0;
+}
+
+// Gives the picker's moves back to the move stack
+void free_move_picker(t_move_picker *picker) {
+	g_move_stack.top = picker->base;
+}
+
+// Most valuable victim, least valuable attacker. Promotions count the piece they promote to.
+int score_capture(struct position *pos, struct move move) {
+	int score = 0;
+
+	if (move.special == MOVE_EN_PASSANT) {
+		score += get_piece_value(PAWN);
+	} else if (pos->board[move.to_square] != NO_PIECE) {
+		score += get_piece_value(TYPE(pos->board[move.to_square]));
+	}
+
+	if (move.special == MOVE_PROMOTION) {
+		score += get_piece_value(promotion_type(move)) - get_piece_value(PAWN);
+	}
+
+	return score * 8 - TYPE(pos->board[move.from_square]);
+}
+
+bool is_usable_move(struct position *pos, const struct attack_map *attacks, struct move move) {
+	return !move_eq(move, NO_MOVE) && is_pseudo_legal(pos, move) && is_legal(pos, move, attacks);
+}
+
+// Returns the next move to search, or NO_MOVE when all moves have been picked
+struct move pick_move(t_move_picker *picker) {
+	struct position *pos = picker->pos;
+
+	switch (picker->stage) {
+	case STAGE_HASH_MOVE: {
+		picker->stage = STAGE_GENERATE_CAPTURES;
+
+		// The hash move may come from another position, so check it instead of generating moves
+		if (is_usable_move(pos, picker->attacks, picker->hash_move)) {
+			return picker->hash_move;
+		}
+		picker->hash_move = NO_MOVE;
+	} // fallthrough
+	case STAGE_GENERATE_CAPTURES: {
+		picker->count = generate_moves(pos, picker->moves, GEN_CAPTURES, picker->attacks);
+		picker->index = 0;
+		g_move_stack.top = picker->base + picker->count;
+		for (size_t i = 0; i < picker->count; i++) {
+			picker->scores[i] = score_capture(pos, picker->moves[i]);
+		}
+		picker->stage = STAGE_CAPTURES;
+	} // fallthrough
+	case STAGE_CAPTURES: {
+		// Selection sort one move at a time, the rest are often never needed
+		while (picker->index < picker->count) {
+			size_t best = picker->index;
+			for (size_t i = picker->index + 1; i < picker->count; i++) {
+				if (picker->scores[i] > picker->scores[best]) {
+					best = i;
+				}
+			}
+
+			struct move move = picker->moves[best];
+			picker->moves[best] = picker->moves[picker->index];
+			picker->scores[best] = picker->scores[picker->index];
+			picker->index++;
+
+			if (!move_eq(move, picker->hash_move)) {
+				return move;
+			}
+		}
+		picker->stage = STAGE_KILLERS;
+	} // fallthrough
+	case STAGE_KILLERS: {
+		while (picker->killer_index < 2) {
+			struct move move = picker->killers[picker->killer_index++];
+
+			// A killer that has become a capture here was already picked with the captures
+			if (!move_eq(move, picker->hash_move) && move.special != MOVE_PROMOTION && move.special != MOVE_EN_PASSANT
+					&& !is_capture(pos, move) && is_usable_move(pos, picker->attacks, move)) {
+				return move;
+			}
+		}
+		picker->stage = STAGE_GENERATE_QUIETS;
+	} // fallthrough
+	case STAGE_GENERATE_QUIETS: {
+		// The captures have all been picked, so the quiets can take their place
+		picker->count = generate_moves(pos, picker->moves, GEN_QUIETS, picker->attacks);
+		picker->index = 0;
+		g_move_stack.top = picker->base + picker->count;
+		score_moves(pos, picker->moves, picker->scores, picker->count, picker->attacks);
+		sort_moves(picker->moves, picker->scores, picker->count);
+		picker->stage = STAGE_QUIETS;
+	} // fallthrough
+	case STAGE_QUIETS: {
+		while (picker->index < picker->count) {
+			struct move move = picker->moves[picker->index++];
+
+			if (!move_eq(move, picker->hash_move) && !move_eq(move, picker->killers[0]) && !move_eq(move, picker->killers[1])) {
+				return move;
+			}
+		}
+		picker->stage = STAGE_DONE;
+	} // fallthrough
+	case STAGE_DONE: {
+		return NO_MOVE;
+	}
+	default: UNREACHABLE();
 	}
 }
 
-void sort_moves(struct move *moves, size_t count) {
-	qsort(moves, count, sizeof(struct move), (int (*)(const void *, const void *))compare_moves);
+void store_killer(struct move move, int ply) {
+	if (ply >= MAX_PLY || move_eq(move, g_killers[ply][0])) {
+		return;
+	}
+
+	g_killers[ply][1] = g_killers[ply][0];
+	g_killers[ply][0] = move;
 }
 
 typedef struct {
@@ -459,8 +653,6 @@ typedef struct {
 	struct move next_move;
 } t_search_res;
 
-#define NO_MOVE ((struct move){.from_square = NO_SQUARE, .to_square = NO_SQUARE, .promotion_type = NO_TYPE})
-
 t_search_res search_neg(t_search_res search_res) {
 	return (t_search_res) {
 		.score = -search_res.score,
@@ -477,31 +669,148 @@ t_search_res search_res(t_score score, struct move move, struct move next_move)
 	};
 }
 
-t_search_res quiescence(t_score alpha, t_score beta) {
-	t_score standpat = evaluate();
-	if (standpat >= beta) {
-		return search_res(beta, NO_MOVE, NO_MOVE);
+/// MAKING MOVES
+
+// do_move on g_pos that also keeps g_history up to date
+void search_do_move(struct move move, struct undo *undo) {
+	ASSERT(g_history.count < MAX_HISTORY);
+
+	g_history.keys[g_history.count++] = g_pos.key;
+	do_move(&g_pos, move, undo);
+}
+
+void search_undo_move(struct move move, const struct undo *undo) {
+	undo_move(&g_pos, move, undo);
+	g_history.count--;
+}
+
+/// TRANSPOSITION TABLE
+
+// The score of the side to move when it is mated at ply plies from the root, so quicker mates score further from 0.
+// Quiescence plies come on top of the MAX_PLY search plies, this stays below SCORE_MIN for both.
+t_score mated_score(int ply) {
+	return SCORE_MIN - (MAX_PLY * 2 - ply);
+}
+
+// Mate scores count the plies from the root to the mate, which differs between nodes reaching the same position.
+// They are stored relative to the node instead, so they stay right when read back at another ply.
+int32_t score_to_tt(t_score score, int ply) {
+	if (score > SCORE_MAX) {
+		return score + ply;
 	}
-	if (alpha < standpat) {
-		alpha = standpat;
+	if (score < SCORE_MIN) {
+		return score - ply;
+	}
+	return score;
+}
+
+t_score score_from_tt(int32_t score, int ply) {
+	if (score > SCORE_MAX) {
+		return score - ply;
+	}
+	if (score < SCORE_MIN) {
+		return score + ply;
+	}
+	return score;
+}
+
+// Whether a stored score settles the node for the given window
+bool is_tt_cutoff(const t_tt_data *tt, t_score score, t_score alpha, t_score beta) {
+	return tt->bound == TT_EXACT
+		|| (tt->bound == TT_LOWER && score >= beta)
+		|| (tt->bound == TT_UPPER && score <= alpha);
+}
+
+int tt_bound(t_score score, t_score alpha, t_score beta) {
+	if (score >= beta) {
+		return TT_LOWER;
+	}
+	if (score > alpha) {
+		return TT_EXACT;
+	}
+	return TT_UPPER;
+}
+
+// ply counts from the root as in negamax. qs_ply counts the quiescence plies, checking moves are only tried on the first
+// one so check sequences can't go on forever.
+t_search_res quiescence(t_score alpha, t_score beta, int ply, int qs_ply) {
+#if DEBUG
+	// The incrementally updated keys and piece square sums must match a recomputation from scratch
+	ASSERT(g_pos.key == zobrist_key(&g_pos));
+	ASSERT(g_pos.pawn_key == zobrist_pawn_key(&g_pos));
+	ASSERT(g_pos.material_key == zobrist_material_key(&g_pos));
+	int32_t psq[2];
+	psq_compute(&g_pos, psq);
+	ASSERT(g_pos.psq[PSQ_MG] == psq[PSQ_MG] && g_pos.psq[PSQ_EG] == psq[PSQ_EG]);
+#endif
+
+	// Any stored result will do, quiescence is depth 0
+	t_tt_data tt;
+	struct move hash_move = NO_MOVE;
+	if (tt_probe(g_pos.key, &tt)) {
+		t_score score = score_from_tt(tt.score, ply);
+		if (is_tt_cutoff(&tt, score, alpha, beta)) {
+			return search_res(score, tt.move, NO_MOVE);
+		}
+		hash_move = tt.move;
+	}
+
+	t_score original_alpha = alpha;
+
+	// One attack map per node, shared by move generation, legality, check detection and the evaluation
+	struct attack_map attacks;
+	init_attack_map(&g_pos, &attacks);
+	uint64_t checkers = attacks.checkers;
+
+	// When in check there is no standing pat, every evasion is searched
+	if (!checkers) {
+		t_score standpat = evaluate(&attacks, alpha, beta);
+		if (standpat >= beta) {
+			tt_store(g_pos.key, NO_MOVE, score_to_tt(standpat, ply), 0, TT_LOWER);
+			return search_res(beta, NO_MOVE, NO_MOVE);
+		}
+		if (alpha < standpat) {
+			alpha = standpat;
+		}
 	}
 
 	t_search_res best_res = search_res(alpha, NO_MOVE, NO_MOVE);
 
-	struct move moves[MAX_MOVES];
-	size_t moves_count = generate_legal_moves(&g_pos, moves);
-	score_moves(&g_pos, moves, moves_count);
-	sort_moves(moves, moves_count);
+	size_t base = g_move_stack.top;
+	struct move *moves = move_stack_peek();
+	int *scores = g_move_stack.scores + base;
+	size_t moves_count;
+
+	if (checkers) {
+		moves_count = generate_moves(&g_pos, moves, GEN_ALL, &attacks);
+		if (moves_count == 0) {
+			tt_store(g_pos.key, NO_MOVE, score_to_tt(mated_score(ply), ply), 0, TT_EXACT);
+			return search_res(mated_score(ply), NO_MOVE, NO_MOVE);
+		}
+		score_moves(&g_pos, moves, scores, moves_count, &attacks);
+	} else {
+		// Only captures and promotions, plus quiet checks on the first ply
+		moves_count = generate_moves(&g_pos, moves, qs_ply == 0 ? GEN_CAPTURES | GEN_QUIET_CHECKS : GEN_CAPTURES, &attacks);
+		for (size_t i = 0; i < moves_count; i++) {
+			scores[i] = score_capture(&g_pos, moves[i]);
+		}
+	}
+
+	// The hash move goes first, if it is one of the moves searched here
 	for (size_t i = 0; i < moves_count; i++) {
-		if (!is_quiescence_move(&g_pos, moves[i])) {
-			continue;
+		if (move_eq(moves[i], hash_move)) {
+			scores[i] = INT_MAX;
 		}
+	}
 
-		// TODO: Figure out a better way to undo a move
-		struct position copy = g_pos;
-		do_move(&g_pos, moves[i]);
-		t_search_res res = search_neg(quiescence(-beta, -alpha));
-		g_pos = copy;
+	g_move_stack.top = base + moves_count;
+
+	sort_moves(moves, scores, moves_count);
+	for (size_t i = 0; i < moves_count; i++) {
+		struct undo undo;
+		search_do_move(moves[i], &undo);
+		t_search_res res = search_neg(quiescence(-beta, -alpha, ply + 1, qs_ply + 1));
+		search_undo_move(moves[i], &undo);
 
 		if (res.score >= beta) {
 			best_res.score = beta;
@@ -517,46 +826,87 @@ t_search_res quiescence(t_score alpha, t_score beta) {
 		}
 	}
 
+	g_move_stack.top = base;
+
+	tt_store(g_pos.key, best_res.move, score_to_tt(best_res.score, ply), 0, tt_bound(best_res.score, original_alpha, beta));
+
 	return best_res;
 }
 
 int g_check_counter = 0;
 
-t_search_res negamax(int depth, t_score alpha, t_score beta) {
+t_search_res negamax(int depth, t_score alpha, t_score beta, int ply) {
 	if (g_check_counter++ % 500 == 0 && should_stop_search(depth)) {
 		return search_res(0, NO_MOVE, NO_MOVE);
 	}
 
+	// Checked first, also at the horizon. Table entries don't know how the position was reached, and quiescence
+	// doesn't look for draws.
+	if (ply > 0 && (is_fifty_move_draw(&g_pos) || is_repetition(&g_pos, &g_history))) {
+		return search_res(0, NO_MOVE, NO_MOVE);
+	}
+
 	if (depth == 0) {
-		return quiescence(alpha, beta);
+		return quiescence(alpha, beta, ply, 0);
 	}
 
+#if DEBUG
+	ASSERT(g_pos.key == zobrist_key(&g_pos));
+	ASSERT(g_pos.pawn_key == zobrist_pawn_key(&g_pos));
+	ASSERT(g_pos.material_key == zobrist_material_key(&g_pos));
+	int32_t psq[2];
+	psq_compute(&g_pos, psq);
+	ASSERT(g_pos.psq[PSQ_MG] == psq[PSQ_MG] && g_pos.psq[PSQ_EG] == psq[PSQ_EG]);
+#endif
+
+	// The root always searches, it has to come up with a move
+	t_tt_data tt;
+	struct move hash_move = NO_MOVE;
+	if (tt_probe(g_pos.key, &tt)) {
+		t_score score = score_from_tt(tt.score, ply);
+		if (ply > 0 && tt.depth >= depth && is_tt_cutoff(&tt, score, alpha, beta)) {
+			return search_res(score, tt.move, NO_MOVE);
+		}
+		hash_move = tt.move;
+	}
+
+	// The previous iteration's best move can't have been replaced, unlike its entry
+	if (ply == 0 && !move_eq(g_root_move, NO_MOVE)) {
+		hash_move = g_root_move;
+	}
+
+	t_score original_alpha = alpha;
 	t_search_res best_res = search_res(SCORE_MIN, NO_MOVE, NO_MOVE);
 
-	struct move moves[MAX_MOVES];
-	size_t moves_count = generate_legal_moves(&g_pos, moves);
-	score_moves(&g_pos, moves, moves_count);
-	sort_moves(moves, moves_count);
+	// One attack map per node, shared by move generation, legality, check detection and move ordering. Every node that
+	// gets this far validates a hash move or generates moves, so it is needed anyway.
+	struct attack_map attacks;
+	init_attack_map(&g_pos, &attacks);
 
-	if (moves_count == 0) {
-		if (is_in_check(&g_pos)) {
-			return search_res(SCORE_MIN - (100 - depth), NO_MOVE, NO_MOVE);
-		} else {
-			return search_res(0, NO_MOVE, NO_MOVE);
+	t_move_picker picker;
+	init_move_picker(&picker, &g_pos, &attacks, hash_move, ply);
+
+	size_t moves_played = 0;
+	struct move move;
+	while (!move_eq(move = pick_move(&picker), NO_MOVE)) {
+#if DEBUG
+		ASSERT(is_legal(&g_pos, move, &attacks));
+#endif
+
+		if (moves_played++ == 0) {
+			best_res.move = move;
 		}
-	}
-	best_res.move = moves[0];
 
-	for (size_t i = 0; i < moves_count; i++) {
-		// TODO: Figure out a better way to undo a move
-		struct position copy = g_pos;
-		do_move(&g_pos, moves[i]);
-		t_search_res res = search_neg(negamax(depth - 1, -beta, -alpha));
-		g_pos = copy;
+		bool quiet = !is_capture(&g_pos, move) && move.special != MOVE_PROMOTION && move.special != MOVE_EN_PASSANT;
+
+		struct undo undo;
+		search_do_move(move, &undo);
+		t_search_res res = search_neg(negamax(depth - 1, -beta, -alpha, ply + 1));
+		search_undo_move(move, &undo);
 
 		if (res.score > best_res.score) {
 			best_res = res;
-			best_res.move = moves[i];
+			best_res.move = move;
 			best_res.next_move = res.move;
 		}
 		if (res.score >= SCORE_MAX) {
@@ -564,33 +914,62 @@ t_search_res negamax(int depth, t_score alpha, t_score beta) {
 		}
 		if (res.score >= beta) {
 			best_res.score = beta;
-			best_res.move = moves[i];
+			best_res.move = move;
 			best_res.next_move = res.move;
+			if (quiet) {
+				store_killer(move, ply);
+			}
 			break;
 		}
 		if (res.score > alpha) {
 			best_res.score = res.score;
-			best_res.move = moves[i];
+			best_res.move = move;
 			best_res.next_move = res.move;
 			alpha = res.score;
 		}
 	}
 
+	free_move_picker(&picker);
+
+	if (moves_played == 0) {
+		if (attacks.checkers) {
+			best_res = search_res(mated_score(ply), NO_MOVE, NO_MOVE);
+		} else {
+			best_res = search_res(0, NO_MOVE, NO_MOVE);
+		}
+	}
+
+	// A stopped search returns made up scores, those must not be stored
+	if (!g_cancel) {
+		tt_store(g_pos.key, best_res.move, score_to_tt(best_res.score, ply), depth, tt_bound(best_res.score, original_alpha, beta));
+	}
+
 	return best_res;
 }
 
 t_search_res search_at_depth(int depth) {
-	return negamax(depth, SCORE_MIN, SCORE_MAX);
+	return negamax(depth, SCORE_MIN, SCORE_MAX, 0);
 }
 
 struct move g_pondering_move;
 
+// Handles commands until one of them stops the search
+void wait_for_stop(void) {
+	struct pollfd fds = { .fd = STDIN_FILENO, .events = POLLIN, .revents = 0 };
+
+	while (!g_cancel) {
+		poll(&fds, 1, -1);
+		update_state();
+	}
+}
+
 void start_pondering(void) {
 #if DEBUG
 	g_dbg_total_ponders++;
 #endif
 
-	do_move(&g_pos, g_pondering_move);
+	struct undo undo;
+	search_do_move(g_pondering_move, &undo);
 	set_state(THINKING_ON_THEIR_TIME);
 	start_search();
 }
@@ -603,6 +982,13 @@ void start_search(void) {
 
 	t_search_res last_res = search_res(0, NO_MOVE, NO_MOVE);
 
+	g_root_move = NO_MOVE;
+	memset(g_killers, 0, sizeof(g_killers));
+	tt_new_search();
+	eval_cache_new_search();
+	g_lazy_exits = 0;
+	g_move_stack.top = 0;
+
 	DEBUGF("Search started\n");
 
 	do {
@@ -611,9 +997,12 @@ void start_search(void) {
 			break;
 		}
 		last_res = res;
+		g_root_move = res.move;
 
 #if DEBUG
 		uci_printf("info depth %d score cp %lld", depth, last_res.score * (g_pos.side_to_move == WHITE ? 1 : -1));
+		uci_printf("info string eval cache hits %llu misses %llu lazy exits %llu", (unsigned long long) g_eval_cache.hits,
+			(unsigned long long) g_eval_cache.misses, (unsigned long long) g_lazy_exits);
 #endif
 
 		depth++;
@@ -622,6 +1011,13 @@ void start_search(void) {
 			DEBUGF("Thinking for too long, playing\n");
 			play_found_move();
 		}
+
+		// Killers, mate scores and stored depths don't go past MAX_PLY. A pondering search has nothing to play yet,
+		// so it waits for the GUI to tell it what to do with its move.
+		if (!g_cancel && depth > MAX_PLY) {
+			DEBUGF("Searched as deep as possible, waiting\n");
+			wait_for_stop();
+		}
 	} while (!g_cancel);
 
 	ASSERT(depth > MIN_DEPTH || g_discard);
@@ -632,6 +1028,7 @@ void start_search(void) {
 
 	// Rollback position
 	g_pos = g_real_pos;
+	g_history = g_real_history;
 
 	// If the search was discarded, we were pondering the wrong move, restart the search
 	if (g_discard) {
@@ -641,49 +1038,61 @@ void start_search(void) {
 		ASSERT(depth >= MIN_DEPTH);  // We should have searched at least at the min depth
 		ASSERT(!move_eq(last_res.move, NO_MOVE));  // We should have found a move
 
+		// Once per search, for the last depth that was completed
+		uci_printf("info depth %d hashfull %d", depth - 1, tt_hashfull());
+
 		char buffer[6];
 
 		buffer[0] = 'a' + FILE(last_res.move.from_square);
 		buffer[1] = '1' + RANK(last_res.move.from_square);
 		buffer[2] = 'a' + FILE(last_res.move.to_square);
 		buffer[3] = '1' + RANK(last_res.move.to_square);
-		buffer[4] = "\0pnbrqk"[last_res.move.promotion_type + 1];
+		buffer[4] = "\0pnbrqk"[promotion_type(last_res.move) + 1];
 		buffer[5] = '\0';
 
 		uci_printf("bestmove %s", buffer);
-		do_move(&g_pos, last_res.move);
+		struct undo undo;
+		search_do_move(last_res.move, &undo);
+
+		// A draw by repetition or the fifty move rule is scored without searching a reply, the hash move may still have one
+		struct move reply = last_res.next_move;
+		t_tt_data tt;
+		if (move_eq(reply, NO_MOVE) && tt_probe(g_pos.key, &tt)) {
+			reply = tt.move;
+		}
 
-		buffer[0] = 'a' + FILE(last_res.next_move.from_square);
-		buffer[1] = '1' + RANK(last_res.next_move.from_square);
-		buffer[2] = 'a' + FILE(last_res.next_move.to_square);
-		buffer[3] = '1' + RANK(last_res.next_move.to_square);
-		buffer[4] = "\0pnbrqk"[last_res.next_move.promotion_type + 1];
+		buffer[0] = 'a' + FILE(reply.from_square);
+		buffer[1] = '1' + RANK(reply.from_square);
+		buffer[2] = 'a' + FILE(reply.to_square);
+		buffer[3] = '1' + RANK(reply.to_square);
+		buffer[4] = "\0pnbrqk"[promotion_type(reply) + 1];
 		buffer[5] = '\0';
 
-#if DEBUG
-		uci_printf("info string pondering %s", buffer);
-		uci_printf("info we're dominating the %s squares", fmt_color(pawn_color(!g_pos.side_to_move)));
-#endif
-
-#if DEBUG
 		struct move moves[MAX_MOVES];
 		size_t moves_count = generate_legal_moves(&g_pos, moves);
 
-		// Check if predicted move is legal
-		bool found = moves_count > 0;
+		// Check if predicted move is legal. There is none after a mate or stalemate.
+		bool found = false;
 		for (size_t i = 0; i < moves_count; i++) {
-			if (move_eq(moves[i], last_res.next_move)) {
+			if (move_eq(moves[i], reply)) {
 				found = true;
 				break;
 			}
 		}
 
-		ASSERT(found);
+#if DEBUG
+		uci_printf("info string pondering %s", found ? buffer : "nothing");
+		uci_printf("info we're dominating the %s squares", fmt_color(pawn_color(!g_pos.side_to_move)));
 #endif
 
-		// Done thinking, start pondering
-		g_pondering_move = last_res.next_move;
-		start_pondering();
+		// Done thinking, start pondering. Without a move to ponder, wait for the next command instead.
+		if (found) {
+			g_pondering_move = reply;
+			start_pondering();
+		} else {
+			g_pondering_move = NO_MOVE;
+			set_state(WAITING_FOR_GO);
+		}
 	}
 }
 
@@ -698,9 +1107,53 @@ void restart_search(void) {
 
 struct move g_last_move;
 
+bool g_game_over = false;
+
 void handle_position(char *token, char *store) {
-	uci_position(&g_real_pos, token, store, &g_last_move);
-	g_pos = g_real_pos;
+	g_game_over = uci_position(&g_real_pos, &g_real_history, token, store, &g_last_move);
+
+	// Moves are undone on g_pos while the search unwinds, so it can't be replaced mid-search.
+	// start_search copies g_real_pos back once the search has stopped.
+	if (g_state == WAITING_FOR_GO) {
+		g_pos = g_real_pos;
+		g_history = g_real_history;
+	}
+}
+
+// setoption name <id> [value <x>], where both may contain spaces
+void handle_setoption(char *token, char *store) {
+	char name[64] = "";
+	char value[256] = "";
+	char *target = NULL;
+	size_t target_size = 0;
+
+	while ((token = get_token(token, store))) {
+		if (streq(token, "name")) {
+			target = name;
+			target_size = sizeof(name);
+		} else if (streq(token, "value")) {
+			target = value;
+			target_size = sizeof(value);
+		} else if (target != NULL) {
+			size_t length = strlen(target);
+			snprintf(target + length, target_size - length, "%s%s", length > 0 ? " " : "", token);
+		}
+	}
+
+	// Option names are case insensitive
+	if (strcasecmp(name, "Hash") == 0) {
+		long megabytes = atol(value);
+		if (megabytes < 1 || megabytes > TT_MAX_MB || !tt_resize(megabytes)) {
+			uci_printf("info string could not set Hash to %s", value);
+		}
+	} else if (strcasecmp(name, "Clear Hash") == 0) {
+		tt_clear();
+	} else if (strcasecmp(name, "HashFile") == 0) {
+		// <empty> is how GUIs send an empty string
+		if (!tt_set_file(streq(value, "<empty>") ? "" : value)) {
+			uci_printf("info string could not use %s as HashFile", value);
+		}
+	}
 }
 
 void handle_go(char *token, char *store) {
@@ -782,6 +1235,9 @@ void update_state(void) {
 			} else if (streq(token, "uci")) {
 				uci_printf("id name checkmate.exe");
 				uci_printf("id author amel-fou mapatenk mwijnsma");
+				uci_printf("option name Hash type spin default %d min 1 max %d", TT_DEFAULT_MB, TT_MAX_MB);
+				uci_printf("option name Clear Hash type button");
+				uci_printf("option name HashFile type string default <empty>");
 				uci_printf("uciok");
 			} else if (streq(token, "isready")) {
 				uci_printf("readyok");
@@ -789,8 +1245,10 @@ void update_state(void) {
 				handle_position(token, &store);
 			} else if (streq(token, "go")) {
 				handle_go(token, &store);
+			} else if (streq(token, "perft")) {
+				perft_run();
 			} else if (streq(token, "setoption")) {
-				break;
+				handle_setoption(token, &store);
 			} else if (streq(token, "register")) {
 				break;
 			} else {
@@ -811,6 +1269,11 @@ int main(void) {
 	ASSERT(g_debug_file != NULL);
 #endif
 
+	init_attacks();
+	init_zobrist();
+	init_psq();
+	tt_resize(TT_DEFAULT_MB);
+
 #ifdef DEBUG_POS
 	ASSERT(parse_position(&g_real_pos, DEBUG_POS) == SUCCESS);
 	g_pos = g_real_pos;
@@ -821,7 +1284,7 @@ int main(void) {
 	set_state(THINKING_ON_OUR_TIME);
 	start_search();
 #else
-	while (!g_pos.game_over) {
+	while (!g_game_over) {
 		update_state();
 	}
 #endif
@@ -0,0 +1,75 @@
+#include "material.h"
+#include "basedboard.h"
+#include "types.h"
+
+#include <string.h>
+
+t_material_entry g_material_table[MATERIAL_TABLE_SIZE];
+
+#define BISHOP_PAIR_BONUS 30
+
+// Weights of the pieces in the game phase
+static const int g_phase_weight[6] = {0, 1, 1, 2, 4, 0};
+
+// Values of the pieces other than pawns and kings, for telling apart material that can't win
+static const int g_piece_value[6] = {0, 320, 330, 500, 900, 0};
+
+// Winning without pawns takes more than a minor piece extra, and a lone minor can't win at all
+// https://www.chessprogramming.org/Draw_Evaluation
+static uint8_t scale_for(const int counts[2][6], const int non_pawn[2], int us) {
+	int them = 1 - us;
+
+	if (counts[us][PAWN] == 0 && non_pawn[us] - non_pawn[them] <= g_piece_value[BISHOP]) {
+		if (non_pawn[us] < g_piece_value[ROOK]) {
+			return 0;
+		}
+		return non_pawn[them] <= g_piece_value[BISHOP] ? 4 : 14;
+	}
+
+	return SCALE_NORMAL;
+}
+
+static bool is_end_game(const int counts[2][6]) {
+	int minor_count = counts[WHITE][KNIGHT] + counts[WHITE][BISHOP] + counts[WHITE][ROOK]
+		+ counts[BLACK][KNIGHT] + counts[BLACK][BISHOP] + counts[BLACK][ROOK];
+	int queen_count = counts[WHITE][QUEEN] + counts[BLACK][QUEEN];
+
+	// if queens are off the board, and less than 9 minor pieces
+	if (queen_count == 0) {
+		return minor_count < 9;
+	}
+
+	// if queens and less than 5 minor pieces
+	if (counts[WHITE][QUEEN] == 1 && counts[BLACK][QUEEN] == 1) {
+		return minor_count < 5;
+	}
+
+	// if one queen off the board and less than 7 minor pieces
+	if (queen_count == 1) {
+		return minor_count < 7;
+	}
+
+	return false;
+}
+
+void compute_material(t_material_entry *entry, const struct position *pos) {
+	int counts[2][6];
+	int non_pawn[2] = {0, 0};
+	int phase = 0;
+
+	for (int c = 0; c < 2; c++) {
+		for (int t = PAWN; t <= KING; t++) {
+			counts[c][t] = bb_count(pos->bbs[c][t]);
+			non_pawn[c] += counts[c][t] * g_piece_value[t];
+			phase += counts[c][t] * g_phase_weight[t];
+		}
+	}
+
+	memset(entry, 0, sizeof(*entry));
+	entry->key = pos->material_key;
+	entry->phase = phase < PHASE_MAX ? phase : PHASE_MAX;
+	entry->imbalance = BISHOP_PAIR_BONUS * ((counts[WHITE][BISHOP] >= 2) - (counts[BLACK][BISHOP] >= 2));
+	entry->scale[WHITE] = scale_for(counts, non_pawn, WHITE);
+	entry->scale[BLACK] = scale_for(counts, non_pawn, BLACK);
+	entry->end_game = is_end_game(counts);
+}
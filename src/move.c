@@ -3,73 +3,129 @@
 #include "generate.h"
 #include "parse.h"
 #include "types.h"
+#include "zobrist.h"
+#include "tt.h"
+#include "psq.h"
 
 struct move make_move(int from_square, int to_square, int promotion_type) {
 	struct move move;
 
 	move.from_square = from_square;
 	move.to_square = to_square;
-	move.promotion_type = promotion_type;
+	move.promotion = 0;
+	move.special = MOVE_NORMAL;
+
+	if (promotion_type != NO_TYPE) {
+		move.promotion = promotion_type - KNIGHT;
+		move.special = MOVE_PROMOTION;
+	}
+
+	return move;
+}
+
+struct move make_special_move(int from_square, int to_square, int special) {
+	struct move move = make_move(from_square, to_square, NO_TYPE);
+
+	move.special = special;
 
 	return move;
 }
 
-int parse_move(struct move *move, const char *string) {
+int parse_move(const struct position *pos, struct move *move, const char *string) {
+	struct move moves[MAX_MOVES];
+	int from_square;
+	int to_square;
+	int type = NO_TYPE;
+	size_t count;
+	size_t index;
+
 	/* parse the from square.                                                */
-	move->from_square = parse_square(string);
+	from_square = parse_square(string);
 
-	if (move->from_square == NO_SQUARE) {
+	if (from_square == NO_SQUARE) {
 		return FAILURE;
 	}
 
 	/* parse the to square.                                                  */
-	move->to_square = parse_square(string + 2);
+	to_square = parse_square(string + 2);
 
-	if (move->to_square == NO_SQUARE) {
+	if (to_square == NO_SQUARE) {
 		return FAILURE;
 	}
 
 	/* parse the promotion type.                                             */
-	move->promotion_type = NO_TYPE;
-
 	if (string[4]) {
-		move->promotion_type = parse_type(string[4]);
+		type = parse_type(string[4]);
 
-		if (move->promotion_type == NO_TYPE) {
+		if (type == NO_TYPE) {
 			return FAILURE;
 		}
 	}
 
-	return SUCCESS;
+	/* look up the move in the list of legal moves, which also tells us if   */
+	/* it is an en passant capture or castling.                              */
+	count = generate_legal_moves(pos, moves);
+
+	for (index = 0; index < count; index++) {
+		if (moves[index].from_square == from_square && moves[index].to_square == to_square && promotion_type(moves[index]) == type) {
+			*move = moves[index];
+
+			return SUCCESS;
+		}
+	}
+
+	return FAILURE;
 }
 
-void do_move(struct position *pos, struct move move) {
-	int from_file = FILE(move.from_square);
+/* `do_move` for the color making the move, see `COLOR_DISPATCH`.            */
+static ALWAYS_INLINE void do_move_for(struct position *pos, struct move move, struct undo *undo, int color) {
 	int from_rank = RANK(move.from_square);
 	int to_file = FILE(move.to_square);
 	int to_rank = RANK(move.to_square);
 	int piece = pos->board[move.from_square];
-	int color = pos->side_to_move;
 	int captured = pos->board[move.to_square];
+	int captured_square = move.to_square;
+	int moved = move.special == MOVE_PROMOTION ? PIECE(color, promotion_type(move)) : piece;
+	int rook = PIECE(color, ROOK);
+	int rook_from = NO_SQUARE;
+	int rook_to = NO_SQUARE;
 	int a1 = SQUARE(FILE_A, RELATIVE(RANK_1, color));
 	int h1 = SQUARE(FILE_H, RELATIVE(RANK_1, color));
 	int a8 = SQUARE(FILE_A, RELATIVE(RANK_8, color));
 	int h8 = SQUARE(FILE_H, RELATIVE(RANK_8, color));
 	int en_passant_square = pos->en_passant_square;
-
-	/* move the piece, promoting it if necessary.                            */
-	pos->board[move.from_square] = NO_PIECE;
-
-	if (move.promotion_type != NO_TYPE) {
-		pos->board[move.to_square] = PIECE(color, move.promotion_type);
-	} else {
-		pos->board[move.to_square] = piece;
+	int en_passant_hashed = en_passant_capturable(pos);
+	uint64_t key = pos->key ^ zobrist_side ^ zobrist_castling[CASTLING_INDEX(pos->castling_rights)];
+	uint64_t pawn_key = pos->pawn_key;
+	uint64_t material_key = pos->material_key;
+	int phase;
+
+	/* save everything that can't be derived from the move itself.           */
+	undo->key = pos->key;
+	undo->pawn_key = pawn_key;
+	undo->material_key = material_key;
+	undo->psq[PSQ_MG] = pos->psq[PSQ_MG];
+	undo->psq[PSQ_EG] = pos->psq[PSQ_EG];
+	undo->captured = captured;
+	undo->castling_rights[WHITE] = pos->castling_rights[WHITE];
+	undo->castling_rights[BLACK] = pos->castling_rights[BLACK];
+	undo->en_passant_square = en_passant_square;
+	undo->halfmove_clock = pos->halfmove_clock;
+
+	/* pawns captured en passant are not on the to square, and castling also */
+	/* moves the rook.                                                       */
+	if (move.special == MOVE_EN_PASSANT) {
+		captured = PIECE(1 - color, PAWN);
+		captured_square = SQUARE(to_file, from_rank);
+	} else if (move.special == MOVE_CASTLING) {
+		rook_from = SQUARE(to_file == FILE_G ? FILE_H : FILE_A, to_rank);
+		rook_to = SQUARE(to_file == FILE_G ? FILE_F : FILE_D, to_rank);
 	}
 
-	/* reset the en passant square.                                          */
+	/* update the state first, so the new hash key is known before any of    */
+	/* the pieces move.                                                      */
 	pos->en_passant_square = NO_SQUARE;
 
-	/* update castling rights.                                               */
 	if (move.from_square == h1) {
 		pos->castling_rights[color] &= ~KING_SIDE;
 	} else if (move.from_square == a1) {
@@ -82,90 +138,187 @@ void do_move(struct position *pos, struct move move) {
 		pos->castling_rights[1 - color] &= ~QUEEN_SIDE;
 	}
 
-	/* update side to move.                                                  */
+	if (TYPE(piece) == KING) {
+		pos->castling_rights[color] = 0;
+	}
+
+	/* set the en passant square for double pawn pushes, if an enemy pawn    */
+	/* can capture on it. otherwise it would only make the key differ from   */
+	/* the same position reached another way.                                */
+	if (TYPE(piece) == PAWN && RELATIVE(to_rank, color) - RELATIVE(from_rank, color) == 2
+		&& (pawn_attacks[color][SQUARE(to_file, RELATIVE(RANK_3, color))] & pos->bbs[1 - color][PAWN])) {
+		pos->en_passant_square = SQUARE(to_file, RELATIVE(RANK_3, color));
+	}
+
 	pos->side_to_move = 1 - color;
 
-	switch (TYPE(piece)) {
-	case PAWN:
-		/* set the en passant square for double pawn pushes.                 */
-		if (RELATIVE(to_rank, color) - RELATIVE(from_rank, color) == 2) {
-			pos->en_passant_square = SQUARE(to_file, RELATIVE(RANK_3, color));
-		}
+	/* captures and pawn moves can't be undone, they reset the clock.        */
+	if (captured != NO_PIECE || TYPE(piece) == PAWN) {
+		pos->halfmove_clock = 0;
+	} else {
+		pos->halfmove_clock++;
+	}
 
-		/* also remove the captured pawn for en passant captures.            */
-		if (move.to_square == en_passant_square) {
-			pos->board[SQUARE(to_file, from_rank)] = NO_PIECE;
-		}
+	/* update the hash key. the castling rights are hashed as a whole, the   */
+	/* old ones were xored out above.                                        */
+	key ^= zobrist_castling[CASTLING_INDEX(pos->castling_rights)];
+	key ^= zobrist_pieces[piece][move.from_square] ^ zobrist_pieces[moved][move.to_square];
 
-		break;
+	if (captured != NO_PIECE) {
+		key ^= zobrist_pieces[captured][captured_square];
+	}
 
-	case KING:
-		/* update castling rights for king moves.                            */
-		pos->castling_rights[color] = 0;
+	if (en_passant_hashed) {
+		key ^= zobrist_en_passant[FILE(en_passant_square)];
+	}
+
+	if (pos->en_passant_square != NO_SQUARE) {
+		key ^= zobrist_en_passant[to_file];
+	}
 
-		/* also move the rook for castling moves.                            */
-		if (from_file == FILE_E && to_file == FILE_G) {
-			pos->board[SQUARE(FILE_H, to_rank)] = NO_PIECE;
-			pos->board[SQUARE(FILE_F, to_rank)] = PIECE(color, ROOK);
-		} else if (from_file == FILE_E && to_file == FILE_C) {
-			pos->board[SQUARE(FILE_A, to_rank)] = NO_PIECE;
-			pos->board[SQUARE(FILE_D, to_rank)] = PIECE(color, ROOK);
+	if (rook_from != NO_SQUARE) {
+		key ^= zobrist_pieces[rook][rook_from] ^ zobrist_pieces[rook][rook_to];
+	}
+
+	pos->key = key;
+
+	/* the pawn key only changes when a pawn moves, promotes or is captured. */
+	if (TYPE(piece) == PAWN) {
+		pawn_key ^= zobrist_pieces[piece][move.from_square];
+
+		if (moved == piece) {
+			pawn_key ^= zobrist_pieces[piece][move.to_square];
 		}
+	}
 
-		break;
+	if (captured != NO_PIECE && TYPE(captured) == PAWN) {
+		pawn_key ^= zobrist_pieces[captured][captured_square];
 	}
 
-	// Remove piece
-	pos->bbs[color][TYPE(piece)] &= ~(1ULL << move.from_square);
+	pos->pawn_key = pawn_key;
 
-	// Remove captured piece
+	/* the material key xors out the number of the last piece of a kind      */
+	/* that is gone, and xors in the number of the next one of a kind that   */
+	/* is added. the counts are taken before any of the pieces move.         */
 	if (captured != NO_PIECE) {
-		pos->bbs[1 - color][TYPE(captured)] &= ~(1ULL << move.to_square);
+		material_key ^= zobrist_pieces[captured][bb_count(pos->bbs[1 - color][TYPE(captured)]) - 1];
 	}
 
-	// Set piece
-	pos->bbs[color][TYPE(piece)] |= 1ULL << move.to_square;
-}
+	if (moved != piece) {
+		material_key ^= zobrist_pieces[piece][bb_count(pos->bbs[color][PAWN]) - 1];
+		material_key ^= zobrist_pieces[moved][bb_count(pos->bbs[color][TYPE(moved)])];
+	}
 
-int is_legal(const struct position *pos, struct move move) {
-	struct position copy = *pos;
-	struct move moves[MAX_MOVES];
-	int piece = pos->board[move.from_square];
-	size_t count;
-	size_t index;
+	pos->material_key = material_key;
 
-	/* make the move on a copy of the position.                              */
-	do_move(&copy, move);
+	/* the search looks the new position up in the transposition table       */
+	/* right away. start loading its bucket while the pieces are moved.      */
+	tt_prefetch(key);
 
-	/* for castling moves, pretend there is another king on all squares      */
-	/* between the from square and the to square. this makes it illegal to   */
-	/* castle through a square that is controlled by the opponent.           */
-	if (TYPE(piece) == KING) {
-		int from_file = FILE(move.from_square);
-		int to_file = FILE(move.to_square);
-		int rank = RELATIVE(RANK_1, pos->side_to_move);
-
-		if (from_file == FILE_E && to_file == FILE_G) {
-			copy.board[SQUARE(FILE_E, rank)] = piece;
-			copy.board[SQUARE(FILE_F, rank)] = piece;
-		} else if (from_file == FILE_E && to_file == FILE_C) {
-			copy.board[SQUARE(FILE_E, rank)] = piece;
-			copy.board[SQUARE(FILE_D, rank)] = piece;
+	/* update the piece square sums with every piece that is removed or      */
+	/* added.                                                                */
+	for (phase = PSQ_MG; phase <= PSQ_EG; phase++) {
+		int32_t psq = pos->psq[phase] - g_psq[piece][move.from_square][phase] + g_psq[moved][move.to_square][phase];
+
+		if (captured != NO_PIECE) {
+			psq -= g_psq[captured][captured_square][phase];
+		}
+
+		if (rook_from != NO_SQUARE) {
+			psq += g_psq[rook][rook_to][phase] - g_psq[rook][rook_from][phase];
 		}
+
+		pos->psq[phase] = psq;
 	}
 
-	/* generate all pseudo-legal moves for the opponent.                     */
-	count = generate_pseudo_legal_moves(&copy, moves);
+	/* remove the captured piece.                                            */
+	if (captured != NO_PIECE) {
+		pos->board[captured_square] = NO_PIECE;
+		pos->bbs[1 - color][TYPE(captured)] &= ~SQUARE_BB(captured_square);
+		pos->colors[1 - color] &= ~SQUARE_BB(captured_square);
+	}
 
-	/* return false if any of those moves could capture the king.            */
-	for (index = 0; index < count; index++) {
-		int piece = copy.board[moves[index].to_square];
+	/* move the piece, which is a different type for promotions.             */
+	pos->board[move.from_square] = NO_PIECE;
+	pos->board[move.to_square] = moved;
+	pos->bbs[color][TYPE(piece)] &= ~SQUARE_BB(move.from_square);
+	pos->bbs[color][TYPE(moved)] |= SQUARE_BB(move.to_square);
+	pos->colors[color] ^= SQUARE_BB(move.from_square) | SQUARE_BB(move.to_square);
+
+	/* also move the rook for castling moves.                                */
+	if (rook_from != NO_SQUARE) {
+		pos->board[rook_from] = NO_PIECE;
+		pos->board[rook_to] = rook;
+		pos->bbs[color][ROOK] ^= SQUARE_BB(rook_from) | SQUARE_BB(rook_to);
+		pos->colors[color] ^= SQUARE_BB(rook_from) | SQUARE_BB(rook_to);
+	}
 
-		if (piece == PIECE(pos->side_to_move, KING)) {
-			return 0;
-		}
+	pos->occupied = pos->colors[WHITE] | pos->colors[BLACK];
+}
+
+/* `undo_move` for the color that made the move, see `COLOR_DISPATCH`.       */
+static ALWAYS_INLINE void undo_move_for(struct position *pos, struct move move, const struct undo *undo, int color) {
+	int to_file = FILE(move.to_square);
+	int from_rank = RANK(move.from_square);
+	int to_rank = RANK(move.to_square);
+	int piece = pos->board[move.to_square];
+
+	/* unpromote the piece, if necessary.                                    */
+	if (move.special == MOVE_PROMOTION) {
+		piece = PIECE(color, PAWN);
 	}
 
-	/* return true if no moves could capture the king.                       */
-	return 1;
+	/* restore the side to move and the irreversible information.            */
+	pos->side_to_move = color;
+	pos->castling_rights[WHITE] = undo->castling_rights[WHITE];
+	pos->castling_rights[BLACK] = undo->castling_rights[BLACK];
+	pos->en_passant_square = undo->en_passant_square;
+	pos->halfmove_clock = undo->halfmove_clock;
+	pos->key = undo->key;
+	pos->pawn_key = undo->pawn_key;
+	pos->material_key = undo->material_key;
+	pos->psq[PSQ_MG] = undo->psq[PSQ_MG];
+	pos->psq[PSQ_EG] = undo->psq[PSQ_EG];
+
+	/* move the piece back, and put back the captured piece.                 */
+	pos->bbs[color][TYPE(pos->board[move.to_square])] &= ~SQUARE_BB(move.to_square);
+	pos->bbs[color][TYPE(piece)] |= SQUARE_BB(move.from_square);
+	pos->board[move.from_square] = piece;
+	pos->board[move.to_square] = undo->captured;
+	pos->colors[color] ^= SQUARE_BB(move.from_square) | SQUARE_BB(move.to_square);
+
+	if (undo->captured != NO_PIECE) {
+		pos->bbs[1 - color][TYPE(undo->captured)] |= SQUARE_BB(move.to_square);
+		pos->colors[1 - color] |= SQUARE_BB(move.to_square);
+	}
+
+	/* put back the pawn captured en passant.                                */
+	if (move.special == MOVE_EN_PASSANT) {
+		pos->board[SQUARE(to_file, from_rank)] = PIECE(1 - color, PAWN);
+		pos->bbs[1 - color][PAWN] |= SQUARE_BB(SQUARE(to_file, from_rank));
+		pos->colors[1 - color] |= SQUARE_BB(SQUARE(to_file, from_rank));
+	}
+
+	/* move the rook back for castling moves.                                */
+	if (move.special == MOVE_CASTLING && to_file == FILE_G) {
+		pos->board[SQUARE(FILE_F, to_rank)] = NO_PIECE;
+		pos->board[SQUARE(FILE_H, to_rank)] = PIECE(color, ROOK);
+		pos->bbs[color][ROOK] ^= SQUARE_BB(SQUARE(FILE_H, to_rank)) | SQUARE_BB(SQUARE(FILE_F, to_rank));
+		pos->colors[color] ^= SQUARE_BB(SQUARE(FILE_H, to_rank)) | SQUARE_BB(SQUARE(FILE_F, to_rank));
+	} else if (move.special == MOVE_CASTLING) {
+		pos->board[SQUARE(FILE_D, to_rank)] = NO_PIECE;
+		pos->board[SQUARE(FILE_A, to_rank)] = PIECE(color, ROOK);
+		pos->bbs[color][ROOK] ^= SQUARE_BB(SQUARE(FILE_A, to_rank)) | SQUARE_BB(SQUARE(FILE_D, to_rank));
+		pos->colors[color] ^= SQUARE_BB(SQUARE(FILE_A, to_rank)) | SQUARE_BB(SQUARE(FILE_D, to_rank));
+	}
+
+	pos->occupied = pos->colors[WHITE] | pos->colors[BLACK];
+}
+
+void do_move(struct position *pos, struct move move, struct undo *undo) {
+	COLOR_DISPATCH(pos->side_to_move, do_move_for, pos, move, undo);
+}
+
+void undo_move(struct position *pos, struct move move, const struct undo *undo) {
+	COLOR_DISPATCH(1 - pos->side_to_move, undo_move_for, pos, move, undo);
 }
@@ -0,0 +1,99 @@
+#include "pawns.h"
+#include "basedboard.h"
+#include "types.h"
+
+// Zeroed, which is also the right entry for positions without pawns, their pawn key is 0
+static t_pawn_entry g_pawn_table[PAWN_TABLE_SIZE];
+
+#define DOUBLED_PENALTY 10
+#define ISOLATED_PENALTY 15
+#define BACKWARD_PENALTY 10
+#define DEFENDED_BONUS 10
+
+// Indexed by rank from the pawn's own side
+static const int32_t g_passed_bonus[8] = {0, 5, 10, 20, 35, 60, 100, 0};
+
+// All terms are computed for every pawn at once by shifting whole bitboards instead of looping over files
+// https://www.chessprogramming.org/Pawn_Structure
+
+static inline uint64_t shift_east(uint64_t bb) {
+	return (bb << 1) & ~FILE_A_BB;
+}
+
+static inline uint64_t shift_west(uint64_t bb) {
+	return (bb >> 1) & ~FILE_H_BB;
+}
+
+static inline uint64_t north_fill(uint64_t bb) {
+	bb |= bb << 8;
+	bb |= bb << 16;
+	bb |= bb << 32;
+	return bb;
+}
+
+static inline uint64_t south_fill(uint64_t bb) {
+	bb |= bb >> 8;
+	bb |= bb >> 16;
+	bb |= bb >> 32;
+	return bb;
+}
+
+// One square forward for pawns of the given color
+static inline uint64_t push(uint64_t bb, int color) {
+	return color == WHITE ? bb << 8 : bb >> 8;
+}
+
+// Every square in front of the pawns of the given color, not including their own squares
+static inline uint64_t front_span(uint64_t bb, int color) {
+	return color == WHITE ? north_fill(bb) << 8 : south_fill(bb) >> 8;
+}
+
+static inline uint64_t attack_set(uint64_t bb, int color) {
+	return push(shift_east(bb) | shift_west(bb), color);
+}
+
+static int32_t evaluate_color(const struct position *pos, int color) {
+	uint64_t ours = pos->bbs[color][PAWN];
+	uint64_t theirs = pos->bbs[1 - color][PAWN];
+	uint64_t files = north_fill(ours) | south_fill(ours);
+	uint64_t our_attacks = attack_set(ours, color);
+	uint64_t their_attacks = attack_set(theirs, 1 - color);
+
+	// A pawn with another of ours in front of it on the same file
+	uint64_t doubled = ours & front_span(ours, 1 - color);
+
+	uint64_t isolated = ours & ~(shift_east(files) | shift_west(files));
+
+	uint64_t defended = ours & our_attacks;
+
+	// No pawn of theirs in front of it on its own or a neighboring file can stop it
+	uint64_t their_span = front_span(theirs, 1 - color);
+	uint64_t passed = ours & ~(their_span | shift_east(their_span) | shift_west(their_span));
+
+	// Its stop square is attacked by a pawn of theirs and none of ours can ever defend it there, as our
+	// pawns on the neighboring files are all further forward. Isolated pawns already paid for that.
+	uint64_t supportable = our_attacks | front_span(our_attacks, color);
+	uint64_t backward = push(push(ours, color) & their_attacks & ~supportable, 1 - color) & ~isolated;
+
+	int32_t score = DEFENDED_BONUS * bb_count(defended)
+		- DOUBLED_PENALTY * bb_count(doubled)
+		- ISOLATED_PENALTY * bb_count(isolated)
+		- BACKWARD_PENALTY * bb_count(backward);
+
+	while (passed) {
+		score += g_passed_bonus[RELATIVE(RANK(bb_pop_lsb(&passed)), color)];
+	}
+
+	return score;
+}
+
+int32_t evaluate_pawns(const struct position *pos) {
+	t_pawn_entry *entry = &g_pawn_table[pos->pawn_key & (PAWN_TABLE_SIZE - 1)];
+
+	if (entry->key != pos->pawn_key) {
+		entry->key = pos->pawn_key;
+		entry->score = evaluate_color(pos, WHITE) - evaluate_color(pos, BLACK);
+	}
+
+	return entry->score;
+}
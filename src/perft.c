@@ -1,9 +1,14 @@
 #include "perft.h"
+#include "attack.h"
 #include "generate.h"
 #include "position.h"
 #include "types.h"
 
 #include <stddef.h>
+#include <time.h>
+
+/* the deepest perft in the table below.                                     */
+#define MAX_PERFT_DEPTH 7
 
 struct perft_data {
 	const char *fen;
@@ -22,8 +27,10 @@ static const struct perft_data perft_data[] = {
 	{ "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 5, 164075551 },
 };
 
-static unsigned long perft(const struct position *pos, int depth) {
-	struct move moves[MAX_MOVES];
+/* count the leaf nodes. `moves` is a stack of moves, every ply generates    */
+/* its moves right after the moves of its parent. it must have room for      */
+/* `MAX_MOVES` moves per ply.                                                */
+static unsigned long perft(struct position *pos, int depth, struct move *moves) {
 	size_t count = generate_legal_moves(pos, moves);
 
 	if (depth == 0) {
@@ -35,26 +42,48 @@ static unsigned long perft(const struct position *pos, int depth) {
 		unsigned long result = 0;
 
 		for (index = 0; index < count; index++) {
-			struct position copy = *pos;
-
-			do_move(&copy, moves[index]);
+			struct undo undo;
 
-			result += perft(&copy, depth - 1);
+			do_move(pos, moves[index], &undo);
+			result += perft(pos, depth - 1, moves + count);
+			undo_move(pos, moves[index], &undo);
 		}
 
 		return result;
 	}
 }
 
+/* returns a monotonic timestamp in seconds.                                 */
+static double get_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 void perft_run(void) {
+	static struct move moves[MAX_MOVES * MAX_PERFT_DEPTH];
 	int count = sizeof perft_data / sizeof *perft_data;
 	int index;
 	int passed = 0;
+	unsigned long total_nodes = 0;
+	double total_time = 0;
+
+	/* the slider attack tables are checked first, the perft positions can't */
+	/* possibly pass if these are wrong.                                     */
+	if (verify_attacks() != SUCCESS) {
+		fprintf(stderr, "%s slider attacks or %s fill do not match\n", ATTACK_BACKEND, FILL_BACKEND);
+	} else {
+		fprintf(stderr, "%s slider attacks and %s fill ok\n", ATTACK_BACKEND, FILL_BACKEND);
+	}
 
 	for (index = 0; index < count; index++) {
 		struct perft_data data = perft_data[index];
 		struct position pos;
 		unsigned long nodes;
+		double start;
+		double elapsed;
 
 		if (parse_position(&pos, data.fen) != SUCCESS) {
 			fprintf(stderr, "test %02d, parse error\n", index);
@@ -62,16 +91,21 @@ void perft_run(void) {
 			continue;
 		}
 
-		nodes = perft(&pos, data.depth);
+		start = get_time();
+		nodes = perft(&pos, data.depth, moves);
+		elapsed = get_time() - start;
+		total_nodes += nodes;
+		total_time += elapsed;
 
 		if (nodes != data.nodes) {
-			fprintf(stderr, "test %02d, %lu nodes, expected %lu\n", index, nodes, data.nodes);
+			fprintf(stderr, "test %02d, %lu nodes, expected %lu, %.2fs\n", index, nodes, data.nodes, elapsed);
 		} else {
-			fprintf(stderr, "test %02d, %lu nodes\n", index, nodes);
+			fprintf(stderr, "test %02d, %lu nodes, %.2fs\n", index, nodes, elapsed);
 
 			passed++;
 		}
 	}
 
 	fprintf(stderr, "%d/%d tests passed\n", passed, count);
+	fprintf(stderr, "%s backend, %.2fs, %.0f nodes per second\n", ATTACK_BACKEND, total_time, total_nodes / total_time);
 }
@@ -1,4 +1,5 @@
 #include "position.h"
+#include "basedboard.h"
 #include "parse.h"
 #include "types.h"
 
@@ -58,6 +59,7 @@ void print_position(const struct position *pos, FILE *stream) {
 	fprintf(stream, "side to move: %c\n", "wb"[pos->side_to_move]);
 	fprintf(stream, "castling rights: %s\n", castling_rights_buffer);
 	fprintf(stream, "en passant square: %s\n", en_passant_square_buffer);
+	fprintf(stream, "halfmove clock: %d\n", pos->halfmove_clock);
 }
 
 int parse_position(struct position *pos, const char *fen) {
@@ -164,7 +166,9 @@ int parse_position(struct position *pos, const char *fen) {
 		return FAILURE;
 	}
 
-	/* ignore halfmove clock and fullmove counter.                           */
+	/* parse the halfmove clock, and ignore the fullmove counter.            */
+	pos->halfmove_clock = 0;
+
 	for (index = 0; index < 2; index++) {
 		if (*fen++ != ' ') {
 			return FAILURE;
@@ -175,6 +179,11 @@ int parse_position(struct position *pos, const char *fen) {
 		}
 
 		while (*fen >= '0' && *fen <= '9') {
+			/* anything past 100 is a draw all the same.                     */
+			if (index == 0 && pos->halfmove_clock <= 100) {
+				pos->halfmove_clock = pos->halfmove_clock * 10 + *fen - '0';
+			}
+
 			fen++;
 		}
 	}
@@ -184,5 +193,7 @@ int parse_position(struct position *pos, const char *fen) {
 		return FAILURE;
 	}
 
+	set_bbs(pos);
+
 	return SUCCESS;
 }
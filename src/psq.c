@@ -0,0 +1,44 @@
+#include "psq.h"
+#include "pst.h"
+#include "types.h"
+
+int32_t g_psq[12][64][2];
+
+// Kings are on the board in every position, their value would always cancel out
+static const int32_t g_material[6] = {100, 320, 330, 500, 900, 0};
+
+static const int *g_tables[6][2] = {
+	{pawn_squares_mid, pawn_squares_end},
+	{knight_squares_mid, knight_squares_end},
+	{bishop_squares_mid, bishop_squares_end},
+	{rook_squares_mid, rook_squares_end},
+	{queen_squares_mid, queen_squares_end},
+	{king_squares_mid, king_squares_end},
+};
+
+void init_psq(void) {
+	for (int type = PAWN; type <= KING; type++) {
+		for (int square = 0; square < 64; square++) {
+			for (int phase = PSQ_MG; phase <= PSQ_EG; phase++) {
+				// The tables are laid out with rank 8 first, white reads them from the far end
+				int32_t white = g_material[type] + g_tables[type][phase][63 - square];
+				int32_t black = g_material[type] + g_tables[type][phase][square];
+
+				g_psq[PIECE(WHITE, type)][square][phase] = white;
+				g_psq[PIECE(BLACK, type)][square][phase] = -black;
+			}
+		}
+	}
+}
+
+void psq_compute(const struct position *pos, int32_t psq[2]) {
+	psq[PSQ_MG] = 0;
+	psq[PSQ_EG] = 0;
+
+	for (int square = 0; square < 64; square++) {
+		if (pos->board[square] != NO_PIECE) {
+			psq[PSQ_MG] += g_psq[pos->board[square]][square][PSQ_MG];
+			psq[PSQ_EG] += g_psq[pos->board[square]][square][PSQ_EG];
+		}
+	}
+}
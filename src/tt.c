@@ -0,0 +1,269 @@
+#include "tt.h"
+#include "zobrist.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+t_tt g_tt;
+
+// The hash file, empty when the table is in anonymous memory
+static char g_tt_path[4096];
+
+// Data word layout: move in bits 0-15, score in 16-47, depth in 48-55, bound in 56-57, age in 58-63
+#define DATA_SCORE(data) ((int32_t) (uint32_t) ((data) >> 16))
+#define DATA_DEPTH(data) ((int) (((data) >> 48) & 0xFF))
+#define DATA_BOUND(data) ((int) (((data) >> 56) & 0x3))
+#define DATA_AGE(data) ((int) ((data) >> 58))
+
+#define AGE_MASK 0x3F
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static uint64_t pack_data(struct move move, int32_t score, int depth, int bound, int age) {
+	uint16_t move_bits;
+
+	memcpy(&move_bits, &move, sizeof(move_bits));
+
+	return (uint64_t) move_bits
+		| (uint64_t) (uint32_t) score << 16
+		| (uint64_t) (depth & 0xFF) << 48
+		| (uint64_t) bound << 56
+		| (uint64_t) (age & AGE_MASK) << 58;
+}
+
+static struct move data_move(uint64_t data) {
+	uint16_t move_bits = data & 0xFFFF;
+	struct move move;
+
+	memcpy(&move, &move_bits, sizeof(move));
+
+	return move;
+}
+
+// Frees or unmaps the current table
+static void release_table(void) {
+	if (g_tt.header != NULL) {
+		munmap(g_tt.header, g_tt.mapped);
+		g_tt.header = NULL;
+	} else {
+		free(g_tt.buckets);
+	}
+	g_tt.buckets = NULL;
+}
+
+static bool allocate_table(size_t bucket_count) {
+	// aligned_alloc wants a multiple of the alignment, only tables below 2 MB need rounding up
+	size_t allocated = (bucket_count * sizeof(t_tt_bucket) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	t_tt_bucket *buckets = aligned_alloc(HUGE_PAGE_SIZE, allocated);
+	if (buckets == NULL) {
+		return false;
+	}
+
+#ifdef MADV_HUGEPAGE
+	// Only a hint, without transparent huge pages this does nothing. Done before the memory is first
+	// touched by tt_clear, so the pages are faulted in as huge pages right away.
+	madvise(buckets, allocated, MADV_HUGEPAGE);
+#endif
+
+	release_table();
+	g_tt.buckets = buckets;
+	g_tt.bucket_count = bucket_count;
+	tt_clear();
+
+	return true;
+}
+
+// Folds all zobrist numbers into one, so a file written with other numbers is recognized
+static uint64_t zobrist_checksum(void) {
+	uint64_t checksum = zobrist_side;
+
+	for (int piece = 0; piece < 12; piece++) {
+		for (int square = 0; square < 64; square++) {
+			checksum = checksum * 31 + zobrist_pieces[piece][square];
+		}
+	}
+	for (int index = 0; index < 16; index++) {
+		checksum = checksum * 31 + zobrist_castling[index];
+	}
+	for (int file = 0; file < 8; file++) {
+		checksum = checksum * 31 + zobrist_en_passant[file];
+	}
+
+	return checksum;
+}
+
+static void init_header(t_tt_file_header *header, size_t bucket_count) {
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, TT_FILE_MAGIC, sizeof(header->magic));
+	header->version = TT_FILE_VERSION;
+	header->bucket_size = sizeof(t_tt_bucket);
+	header->bucket_count = bucket_count;
+	header->zobrist_checksum = zobrist_checksum();
+}
+
+static bool map_table(const char *path, size_t bucket_count) {
+	size_t size = TT_FILE_HEADER_SIZE + bucket_count * sizeof(t_tt_bucket);
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		return false;
+	}
+
+	// The entries are only used if everything about their layout matches, anything else is wiped
+	t_tt_file_header expected;
+	t_tt_file_header found;
+	struct stat st;
+	init_header(&expected, bucket_count);
+	bool valid = fstat(fd, &st) == 0 && (size_t) st.st_size == size
+		&& pread(fd, &found, sizeof(found), 0) == sizeof(found)
+		&& memcmp(&found, &expected, offsetof(t_tt_file_header, age)) == 0;
+
+	// Truncating to nothing and back zeroes the file without writing all of it
+	if (!valid && (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0)) {
+		close(fd);
+		return false;
+	}
+
+	void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		return false;
+	}
+
+	release_table();
+	g_tt.header = memory;
+	g_tt.mapped = size;
+	g_tt.buckets = (t_tt_bucket *) ((char *) memory + TT_FILE_HEADER_SIZE);
+	g_tt.bucket_count = bucket_count;
+
+	if (valid) {
+		g_tt.age = g_tt.header->age;
+	} else {
+		init_header(g_tt.header, bucket_count);
+		g_tt.age = 0;
+	}
+
+	return true;
+}
+
+static bool create_table(size_t bucket_count) {
+	return g_tt_path[0] ? map_table(g_tt_path, bucket_count) : allocate_table(bucket_count);
+}
+
+bool tt_resize(size_t megabytes) {
+	size_t bucket_count = 1;
+
+	while (bucket_count * 2 * sizeof(t_tt_bucket) <= megabytes * 1024 * 1024) {
+		bucket_count *= 2;
+	}
+
+	return create_table(bucket_count);
+}
+
+bool tt_set_file(const char *path) {
+	char previous[sizeof(g_tt_path)];
+
+	if (strlen(path) >= sizeof(g_tt_path)) {
+		return false;
+	}
+
+	memcpy(previous, g_tt_path, sizeof(previous));
+	strcpy(g_tt_path, path);
+	if (!create_table(g_tt.bucket_count)) {
+		memcpy(g_tt_path, previous, sizeof(previous));
+		return false;
+	}
+
+	return true;
+}
+
+// The age goes in the file header too, so the next process continues from it
+static void set_age(uint8_t age) {
+	g_tt.age = age;
+	if (g_tt.header != NULL) {
+		g_tt.header->age = age;
+	}
+}
+
+void tt_clear(void) {
+	memset(g_tt.buckets, 0, g_tt.bucket_count * sizeof(t_tt_bucket));
+	set_age(0);
+}
+
+void tt_new_search(void) {
+	set_age((g_tt.age + 1) & AGE_MASK);
+}
+
+int tt_hashfull(void) {
+	int used = 0;
+
+	// The first buckets are as good a sample as any, keys are random. Even a 1 MB table has enough of them.
+	for (size_t i = 0; i < 1000 / TT_BUCKET_SIZE; i++) {
+		for (int j = 0; j < TT_BUCKET_SIZE; j++) {
+			uint64_t data = g_tt.buckets[i].entries[j].data;
+
+			if (DATA_BOUND(data) != TT_NONE && DATA_AGE(data) == g_tt.age) {
+				used++;
+			}
+		}
+	}
+
+	return used;
+}
+
+bool tt_probe(uint64_t key, t_tt_data *data) {
+	t_tt_bucket *bucket = tt_bucket(key);
+
+	for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+		uint64_t entry_data = bucket->entries[i].data;
+
+		if ((bucket->entries[i].key ^ entry_data) == key && DATA_BOUND(entry_data) != TT_NONE) {
+			data->move = data_move(entry_data);
+			data->score = DATA_SCORE(entry_data);
+			data->depth = DATA_DEPTH(entry_data);
+			data->bound = DATA_BOUND(entry_data);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void tt_store(uint64_t key, struct move move, int32_t score, int depth, int bound) {
+	t_tt_bucket *bucket = tt_bucket(key);
+	t_tt_entry *replace = NULL;
+	int replace_worth = 0;
+
+	for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+		t_tt_entry *entry = &bucket->entries[i];
+		uint64_t entry_data = entry->data;
+
+		if ((entry->key ^ entry_data) == key && DATA_BOUND(entry_data) != TT_NONE) {
+			// Don't let a shallower result of this search overwrite a deeper one of the same position, whatever its
+			// bound. Quiescence stores exact depth 0 results of positions the main search also reaches.
+			if (DATA_AGE(entry_data) == g_tt.age && DATA_DEPTH(entry_data) > depth) {
+				return;
+			}
+			// Keep the old move rather than none, it is still the best guess
+			if (move_eq(move, NO_MOVE)) {
+				move = data_move(entry_data);
+			}
+			replace = entry;
+			break;
+		}
+
+		// Empty entries go first, then entries of older searches, then shallow ones
+		int worth = DATA_BOUND(entry_data) == TT_NONE ? -1000 : DATA_DEPTH(entry_data) - 8 * ((g_tt.age - DATA_AGE(entry_data)) & AGE_MASK);
+		if (replace == NULL || worth < replace_worth) {
+			replace = entry;
+			replace_worth = worth;
+		}
+	}
+
+	uint64_t data = pack_data(move, score, depth, bound, g_tt.age);
+	replace->key = key ^ data;
+	replace->data = data;
+}
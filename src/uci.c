@@ -3,7 +3,6 @@
 #include "move.h"
 #include "types.h"
 #include "generate.h"
-#include "basedboard.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -54,10 +53,9 @@ char *get_token(char *string, char *store) {
 	return NULL;
 }
 
-void uci_position(struct position *pos, char *token, char *store, struct move *last_move) {
-	pos->game_over = false;
-	
+bool uci_position(struct position *pos, struct history *history, char *token, char *store, struct move *last_move) {
 	token = get_token(token, store);
+	history->count = 0;
 
 	if (token && !strcmp(token, "startpos")) {
 		parse_position(pos, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
@@ -81,17 +79,21 @@ void uci_position(struct position *pos, char *token, char *store, struct move *l
 	if (token && !strcmp(token, "moves")) {
 		while ((token = get_token(token, store))) {
 			struct move move;
+			struct undo undo;
 
-			if (parse_move(&move, token) == SUCCESS) {
+			if (parse_move(pos, &move, token) == SUCCESS) {
 				if (last_move) *last_move = move;
-				do_move(pos, move);
+				history->keys[history->count++] = pos->key;
+				do_move(pos, move, &undo);
+
+				/* the positions before an irreversible move can't repeat.   */
+				if (pos->halfmove_clock == 0) {
+					history->count = 0;
+				}
 			}
 		}
 	}
 
 	struct move moves[MAX_MOVES];
-	if (generate_legal_moves(pos, moves) == 0) {
-		pos->game_over = true;
-	}
-	set_bbs(pos);
+	return generate_legal_moves(pos, moves) == 0;
 }
@@ -0,0 +1,92 @@
+#include "zobrist.h"
+#include "types.h"
+
+uint64_t zobrist_pieces[12][64];
+uint64_t zobrist_castling[16];
+uint64_t zobrist_en_passant[8];
+uint64_t zobrist_side;
+
+/* splitmix64 pseudo random number generator. the seed is fixed so keys are  */
+/* the same every time the engine starts.                                    */
+static uint64_t random_u64(uint64_t *state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+void init_zobrist(void) {
+	uint64_t state = 0x5A0B2157ULL;
+	int piece;
+	int square;
+	int index;
+
+	for (piece = 0; piece < 12; piece++) {
+		for (square = 0; square < 64; square++) {
+			zobrist_pieces[piece][square] = random_u64(&state);
+		}
+	}
+
+	/* no castling rights at all hash to nothing, like an empty square.      */
+	zobrist_castling[0] = 0;
+
+	for (index = 1; index < 16; index++) {
+		zobrist_castling[index] = random_u64(&state);
+	}
+
+	for (index = 0; index < 8; index++) {
+		zobrist_en_passant[index] = random_u64(&state);
+	}
+
+	zobrist_side = random_u64(&state);
+}
+
+uint64_t zobrist_key(const struct position *pos) {
+	uint64_t key = zobrist_castling[CASTLING_INDEX(pos->castling_rights)];
+	int square;
+
+	for (square = 0; square < 64; square++) {
+		if (pos->board[square] != NO_PIECE) {
+			key ^= zobrist_pieces[pos->board[square]][square];
+		}
+	}
+
+	if (en_passant_capturable(pos)) {
+		key ^= zobrist_en_passant[FILE(pos->en_passant_square)];
+	}
+
+	if (pos->side_to_move == BLACK) {
+		key ^= zobrist_side;
+	}
+
+	return key;
+}
+
+uint64_t zobrist_pawn_key(const struct position *pos) {
+	uint64_t key = 0;
+	int square;
+
+	for (square = 0; square < 64; square++) {
+		if (pos->board[square] != NO_PIECE && TYPE(pos->board[square]) == PAWN) {
+			key ^= zobrist_pieces[pos->board[square]][square];
+		}
+	}
+
+	return key;
+}
+
+uint64_t zobrist_material_key(const struct position *pos) {
+	uint64_t key = 0;
+	int counts[12] = { 0 };
+	int square;
+
+	for (square = 0; square < 64; square++) {
+		if (pos->board[square] != NO_PIECE) {
+			key ^= zobrist_pieces[pos->board[square]][counts[pos->board[square]]++];
+		}
+	}
+
+	return key;
+}